@@ -0,0 +1,217 @@
+#!/bin/bash
+# Benchmarks of ubash, run with: make bench
+#
+# Every workload is a script executed by the ubash binary, the best time of REPS runs is kept.
+# Results:
+#  - bench/results/latest.json	results of this run
+#  - bench/results/history.csv	one row per result of every run (date, commit, workload, metric, value, unit)
+# A metric worse than the previous run of the same workload by more than THRESHOLD percent is reported as
+# REGRESSION, with STRICT=1 the script then exits with status 1.
+#
+# Settings (environment variables): UBASH, REPS, SPAWN_N, STAGES, PIPE_N, LONG_STAGES, LONG_N, THROUGHPUT_MB, REDIR_N,
+# PARSE_LINES, PARSE_LEN, REPEAT_LINES, SERVER_N, HEAP_VARS,
+# THRESHOLD, STRICT, UBASH_SPAWN (passed to ubash).
+
+cd "$(dirname "$0")/.." || exit 1
+
+UBASH=${UBASH:-./ubash}
+REPS=${REPS:-5}
+SPAWN_N=${SPAWN_N:-2000}
+STAGES=${STAGES:-2 8 32}
+PIPE_N=${PIPE_N:-100}
+LONG_STAGES=${LONG_STAGES:-128 512 2048}
+LONG_N=${LONG_N:-3}
+THROUGHPUT_MB=${THROUGHPUT_MB:-256}
+REDIR_N=${REDIR_N:-1000}
+PARSE_LINES=${PARSE_LINES:-20000}
+PARSE_LEN=${PARSE_LEN:-900}
+REPEAT_LINES=${REPEAT_LINES:-20000}
+SERVER_N=${SERVER_N:-500}
+HEAP_VARS=${HEAP_VARS:-200000}
+THRESHOLD=${THRESHOLD:-10}
+STRICT=${STRICT:-0}
+
+RESULTS=bench/results
+WORK=$(mktemp -d "${TMPDIR:-/tmp}/ubash-bench.XXXXXX")
+trap '[ -n "$SERVER" ] && kill "$SERVER"; rm -rf "$WORK"' EXIT
+mkdir -p "$RESULTS"
+HISTORY=$RESULTS/history.csv
+[ -f "$HISTORY" ] || echo "date,commit,spawn,workload,metric,value,unit" > "$HISTORY"
+DATE=$(date -u +%Y-%m-%dT%H:%M:%SZ)
+COMMIT=$(git rev-parse --short HEAD 2>/dev/null || echo unknown)
+SPAWN=${UBASH_SPAWN:-posix_spawn}
+JSON=""
+REGRESSIONS=0
+SERVER=""
+
+if [ ! -x "$UBASH" ]; then
+	echo "bench: $UBASH not found, run make first" >&2
+	exit 1
+fi
+
+# best time in nanoseconds of REPS runs of: ubash [options] script
+best_ns() {
+	local best=0 start end t
+	for ((r = 0; r < REPS; r++)); do
+		start=$(date +%s%N)
+		"$UBASH" "$@" >/dev/null 2>&1 </dev/null
+		end=$(date +%s%N)
+		t=$((end - start))
+		if [ "$best" -eq 0 ] || [ "$t" -lt "$best" ]; then
+			best=$t
+		fi
+	done
+	echo "$best"
+}
+
+# best time in nanoseconds of REPS runs of n times: ubash [options]
+best_loop_ns() {
+	local n=$1 best=0 start end t i
+	shift
+	for ((r = 0; r < REPS; r++)); do
+		start=$(date +%s%N)
+		for ((i = 0; i < n; i++)); do "$UBASH" "$@" >/dev/null 2>&1 </dev/null; done
+		end=$(date +%s%N)
+		t=$((end - start))
+		if [ "$best" -eq 0 ] || [ "$t" -lt "$best" ]; then
+			best=$t
+		fi
+	done
+	echo "$best"
+}
+
+# record workload metric value unit lower_is_better(1/0)
+record() {
+	local prev
+	prev=$(awk -F, -v s="$SPAWN" -v w="$1" -v m="$2" '$3 == s && $4 == w && $5 == m { v = $6 } END { print v }' "$HISTORY")
+	echo "$DATE,$COMMIT,$SPAWN,$1,$2,$3,$4" >> "$HISTORY"
+	JSON="$JSON${JSON:+,}
+    {\"workload\": \"$1\", \"metric\": \"$2\", \"value\": $3, \"unit\": \"$4\"}"
+	if [ -n "$prev" ]; then
+		awk -v old="$prev" -v new="$3" -v lower="$5" -v t="$THRESHOLD" -v name="$1 $2" 'BEGIN {
+			d = (old == 0) ? 0 : (new - old) * 100 / old
+			worse = lower ? d : -d
+			printf "  %-28s %12s   (%+.1f%% vs previous run)%s\n", name, new, d, (worse > t) ? "  REGRESSION" : ""
+			exit (worse > t)
+		}' || REGRESSIONS=$((REGRESSIONS + 1))
+	else
+		printf "  %-28s %12s\n" "$1 $2" "$3"
+	fi
+}
+
+echo "ubash benchmarks - commit $COMMIT, spawn backend $SPAWN, best of $REPS runs"
+
+# single-command spawn latency
+for ((i = 0; i < SPAWN_N; i++)); do echo "/bin/true"; done > "$WORK/spawn.sh"
+ns=$(best_ns "$WORK/spawn.sh")
+record spawn us_per_command $((ns / SPAWN_N / 1000)) us 1
+
+# spawn latency of each backend, in a new shell and after HEAP_VARS variables have grown its heap
+awk -v n="$HEAP_VARS" 'BEGIN { for (i = 0; i < n; i++) printf "V%d=value_that_grows_the_heap_%d\n", i, i }' > "$WORK/heap.sh"
+cat "$WORK/heap.sh" "$WORK/spawn.sh" > "$WORK/heapspawn.sh"
+heap_ns=$(best_ns "$WORK/heap.sh")
+for backend in posix_spawn fork zygote; do
+	ns=$(UBASH_SPAWN=$backend best_ns "$WORK/spawn.sh")
+	record "spawn_$backend" us_per_command $((ns / SPAWN_N / 1000)) us 1
+	ns=$(UBASH_SPAWN=$backend best_ns "$WORK/heapspawn.sh")
+	record "spawn_heap_$backend" us_per_command $(((ns - heap_ns) / SPAWN_N / 1000)) us 1
+done
+
+# N-stage pipeline setup time
+for n in $STAGES; do
+	line="/bin/true"
+	for ((i = 1; i < n; i++)); do line="$line | /bin/true"; done
+	for ((i = 0; i < PIPE_N; i++)); do echo "$line"; done > "$WORK/pipe$n.sh"
+	ns=$(best_ns "$WORK/pipe$n.sh")
+	record "pipeline_$n" us_per_pipeline $((ns / PIPE_N / 1000)) us 1
+done
+
+# very long pipelines: the cost per command must not grow with the number of commands
+for n in $LONG_STAGES; do
+	line="/bin/true"
+	for ((i = 1; i < n; i++)); do line="$line | /bin/true"; done
+	for ((i = 0; i < LONG_N; i++)); do echo "$line"; done > "$WORK/long$n.sh"
+	ns=$(best_ns "$WORK/long$n.sh")
+	record "long_pipeline_$n" us_per_stage $((ns / LONG_N / n / 1000)) us 1
+done
+
+# pipeline byte throughput, external cat against the build in cat (zero-copy)
+head -c $((THROUGHPUT_MB * 1024 * 1024)) /dev/zero > "$WORK/big"
+echo "/bin/cat $WORK/big | /bin/cat | /bin/cat >/dev/null" > "$WORK/throughput.sh"
+ns=$(best_ns "$WORK/throughput.sh")
+record throughput MB_per_s $((THROUGHPUT_MB * 1000000000 / ns)) MB/s 0
+echo "cat $WORK/big | cat | cat >/dev/null" > "$WORK/throughput_builtin.sh"
+ns=$(best_ns "$WORK/throughput_builtin.sh")
+record throughput_builtin MB_per_s $((THROUGHPUT_MB * 1000000000 / ns)) MB/s 0
+
+# CPU-heavy pipeline, stages placed by the kernel against each stage on its own core (CPUS=auto)
+echo "cat $WORK/big | tr a-y b-z | tr b-z a-y | cksum >/dev/null" > "$WORK/cpu.sh"
+printf 'CPUS=auto\n' | cat - "$WORK/cpu.sh" > "$WORK/cpu_auto.sh"
+ns=$(best_ns "$WORK/cpu.sh")
+record cpu_pipeline MB_per_s $((THROUGHPUT_MB * 1000000000 / ns)) MB/s 0
+ns=$(best_ns "$WORK/cpu_auto.sh")
+record cpu_pipeline_auto MB_per_s $((THROUGHPUT_MB * 1000000000 / ns)) MB/s 0
+
+# redirection-heavy loop, external cat against the build in cat
+echo "some text for the redirection benchmark" > "$WORK/in"
+for ((i = 0; i < REDIR_N; i++)); do echo "/bin/cat <$WORK/in >$WORK/out"; done > "$WORK/redir.sh"
+ns=$(best_ns "$WORK/redir.sh")
+record redirection us_per_command $((ns / REDIR_N / 1000)) us 1
+for ((i = 0; i < REDIR_N; i++)); do echo "cat <$WORK/in >$WORK/out"; done > "$WORK/redir_builtin.sh"
+ns=$(best_ns "$WORK/redir_builtin.sh")
+record redirection_builtin us_per_command $((ns / REDIR_N / 1000)) us 1
+
+# parse-only throughput of long lines (ubash -n)
+awk -v n="$PARSE_LINES" -v len="$PARSE_LEN" 'BEGIN {
+	for (i = 0; i < n; i++) {
+		line = "cmd <in"
+		while (length(line) < len - 20)
+			line = line " | next -a " length(line) " $HOME"
+		print line " >out"
+	}
+}' > "$WORK/parse.sh"
+bytes=$(wc -c < "$WORK/parse.sh")
+ns=$(best_ns -n "$WORK/parse.sh")
+record parse MB_per_s $((bytes * 1000 / ns)) MB/s 0
+record parse ns_per_line $((ns / PARSE_LINES)) ns 1
+
+# the same line executed many times (plan cache), a build in so nothing is spawned
+line="true"
+for ((i = 0; i < 40; i++)); do line="$line -o$i value$i"; done
+for ((i = 0; i < REPEAT_LINES; i++)); do echo "$line"; done > "$WORK/repeat.sh"
+ns=$(best_ns "$WORK/repeat.sh")
+record repeated_line ns_per_line $((ns / REPEAT_LINES)) ns 1
+
+# the same command in a for loop, compiled once
+echo "for i in $(seq -s ' ' "$REPEAT_LINES"); do true -o \$i value; done" > "$WORK/loop.sh"
+ns=$(best_ns "$WORK/loop.sh")
+record for_loop ns_per_iteration $((ns / REPEAT_LINES)) ns 1
+
+# a command sent by a client to a server (ubash -l), against a new ubash for each command
+"$UBASH" -l "$WORK/ubash.sock" >/dev/null 2>&1 </dev/null &
+SERVER=$!
+for ((i = 0; i < 50; i++)); do
+	[ -S "$WORK/ubash.sock" ] && break
+	sleep 0.1
+done
+ns=$(best_loop_ns "$SERVER_N" -r "$WORK/ubash.sock" -c true)
+record server_request us_per_request $((ns / SERVER_N / 1000)) us 1
+ns=$(best_loop_ns "$SERVER_N" -c true)
+record cold_start us_per_request $((ns / SERVER_N / 1000)) us 1
+
+cat > "$RESULTS/latest.json" <<JSON_END
+{
+  "date": "$DATE",
+  "commit": "$COMMIT",
+  "spawn": "$SPAWN",
+  "reps": $REPS,
+  "results": [$JSON
+  ]
+}
+JSON_END
+echo "results: $RESULTS/latest.json, history: $HISTORY"
+if [ "$REGRESSIONS" -gt 0 ]; then
+	echo "$REGRESSIONS regression(s) over $THRESHOLD%"
+	[ "$STRICT" = 1 ] && exit 1
+fi
+exit 0
@@ -0,0 +1,135 @@
+#include <stdlib.h>
+#include <stdalign.h>
+#include "arena.h"
+
+
+/**************************************************************************************************************************
+Create the arena, the first block is allocated at the first arenaAlloc
+**************************************************************************************************************************/
+void arenaInit(arena * a, size_t blockDim)
+{
+	a->head = NULL;
+	a->blockDim = blockDim;
+	a->allocs = 0;
+	a->bytes = 0;
+	a->mallocs = 0;
+	a->resets = 0;
+	a->peak = 0;
+}
+
+
+/**************************************************************************************************************************
+Bytes used in all the blocks of the arena
+**************************************************************************************************************************/
+static size_t arenaUsed(const arena * a)
+{
+	size_t used = 0;
+	for (arenaBlock *b = a->head; b != NULL; b = b->next)
+		used += b->used;
+	return used;
+}
+
+
+/**************************************************************************************************************************
+Take dim bytes (aligned for every type) from the arena.
+Return NULL if there is an error, else the memory
+**************************************************************************************************************************/
+void *arenaAlloc(arena * a, size_t dim)
+{
+	const size_t align = alignof(max_align_t);
+	arenaBlock *b = a->head;
+	void *mem;
+	dim = (dim + align - 1) & ~(align - 1);
+	if (b == NULL || b->dim - b->used < dim) {	// new block in front of the list
+		size_t blockDim = dim > a->blockDim ? dim : a->blockDim;
+		if ((b = malloc(sizeof(arenaBlock) + blockDim)) == NULL)
+			return NULL;
+		b->dim = blockDim;
+		b->used = 0;
+		b->next = a->head;
+		a->head = b;
+		a->mallocs++;
+	}
+	mem = b->data + b->used;
+	b->used += dim;
+	a->allocs++;
+	a->bytes += dim;
+	return mem;
+}
+
+
+/**************************************************************************************************************************
+Release all the memory taken from the arena. The biggest block is kept for the next command line
+**************************************************************************************************************************/
+void arenaReset(arena * a)
+{
+	arenaBlock *keep = a->head, *next;
+	size_t used = arenaUsed(a);
+	if (used > a->peak)
+		a->peak = used;
+	for (arenaBlock *b = a->head; b != NULL; b = b->next)	// find the biggest block
+		if (b->dim > keep->dim)
+			keep = b;
+	for (arenaBlock *b = a->head; b != NULL; b = next) {
+		next = b->next;
+		if (b != keep)
+			free(b);
+	}
+	if (keep != NULL) {
+		keep->used = 0;
+		keep->next = NULL;
+		if (used > keep->dim && used > a->blockDim)	// next time the line fits in one block
+			a->blockDim = used;
+	}
+	a->head = keep;
+	a->resets++;
+}
+
+
+/**************************************************************************************************************************
+Save the position of the arena
+**************************************************************************************************************************/
+arenaMark arenaSave(const arena * a)
+{
+	return (arenaMark) { a->head, a->head != NULL ? a->head->used : 0 };
+}
+
+
+/**************************************************************************************************************************
+Release the memory taken from the arena after the mark (the blocks added after it are freed)
+**************************************************************************************************************************/
+void arenaRestore(arena * a, arenaMark mark)
+{
+	arenaBlock *next;
+	while (a->head != mark.head) {
+		next = a->head->next;
+		free(a->head);
+		a->head = next;
+	}
+	if (a->head != NULL)
+		a->head->used = mark.used;
+}
+
+
+/**************************************************************************************************************************
+Free all the blocks of the arena
+**************************************************************************************************************************/
+void arenaFree(arena * a)
+{
+	arenaBlock *next;
+	for (arenaBlock *b = a->head; b != NULL; b = next) {
+		next = b->next;
+		free(b);
+	}
+	a->head = NULL;
+}
+
+
+/**************************************************************************************************************************
+Print the counters of the arena on the stream
+**************************************************************************************************************************/
+void arenaStats(const arena * a, FILE * out)
+{
+	fprintf(out, "arena: %lu lines, %lu allocations, %lu bytes, %lu malloc, peak %zu bytes per line\n",
+		a->resets, a->allocs, a->bytes, a->mallocs, a->peak);
+}
@@ -0,0 +1,86 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#define ARENABLOCK 16384	// default dimension of a block of the arena
+
+
+/**************************************************************************************************************************
+Block of memory of the arena, the memory is given in order from data
+**************************************************************************************************************************/
+typedef struct arenaBlock {
+	struct arenaBlock *next;
+	size_t dim, used;
+	char data[];
+} arenaBlock;
+
+
+/**************************************************************************************************************************
+Arena Struct: memory for the objects of one command line, freed all together by arenaReset.
+The counters measure how many allocations are served without malloc
+**************************************************************************************************************************/
+typedef struct {
+	arenaBlock *head;
+	size_t blockDim;
+	unsigned long allocs;	// allocations served by the arena
+	unsigned long bytes;	// bytes given by the arena
+	unsigned long mallocs;	// blocks requested to malloc
+	unsigned long resets;	// number of arenaReset
+	size_t peak;		// max bytes used between two arenaReset
+} arena;
+
+
+/**************************************************************************************************************************
+Position in the arena saved by arenaSave: the memory taken after it is released by arenaRestore
+**************************************************************************************************************************/
+typedef struct {
+	arenaBlock *head;
+	size_t used;
+} arenaMark;
+
+
+/**************************************************************************************************************************
+Create the arena, the first block is allocated at the first arenaAlloc
+**************************************************************************************************************************/
+void arenaInit(arena *, size_t);
+
+
+/**************************************************************************************************************************
+Take dim bytes (aligned for every type) from the arena.
+Return NULL if there is an error, else the memory
+**************************************************************************************************************************/
+void *arenaAlloc(arena *, size_t);
+
+
+/**************************************************************************************************************************
+Release all the memory taken from the arena. The biggest block is kept for the next command line
+**************************************************************************************************************************/
+void arenaReset(arena *);
+
+
+/**************************************************************************************************************************
+Save the position of the arena
+**************************************************************************************************************************/
+arenaMark arenaSave(const arena *);
+
+
+/**************************************************************************************************************************
+Release the memory taken from the arena after the mark (the blocks added after it are freed)
+**************************************************************************************************************************/
+void arenaRestore(arena *, arenaMark);
+
+
+/**************************************************************************************************************************
+Free all the blocks of the arena
+**************************************************************************************************************************/
+void arenaFree(arena *);
+
+
+/**************************************************************************************************************************
+Print the counters of the arena on the stream
+**************************************************************************************************************************/
+void arenaStats(const arena *, FILE *);
+
+#endif
@@ -0,0 +1,411 @@
+#define _GNU_SOURCE
+
+#include <unistd.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <errno.h>
+#include "builtins.h"
+#include "pathcache.h"
+#include "jobs.h"
+#include "parallel.h"
+#include "zerocopy.h"
+#include "spawn.h"
+#include "session.h"
+#include "variables.h"
+#include "history.h"
+
+
+/**************************************************************************************************************************
+Build in cd command.
+Return 0 if there is an error, else 1.
+**************************************************************************************************************************/
+static unsigned int cdBuiltin(char **args, int num_arg, int fd_in, int fd_out)
+{
+	char *dir = args[1];
+	(void)fd_in;
+	(void)fd_out;
+	if (num_arg > 2) {	// arguments error
+		fprintf(stdout, RED "micro-bash: cd: too much arguments" RESET_COLOR "\n");
+		return 0;
+	} else if (num_arg == 1 || strcmp(dir, "-") == 0 || strcmp(dir, "~") == 0) {	// no arguments, "cd -" or "cd ~"
+		if (!sessionChdir(getVar("HOME") != NULL ? getVar("HOME") : "/"))
+			fprintf(stdout, RED "micro-bash: cd: %s: File or directory doesn't exist" RESET_COLOR "\n", dir);
+		return 1;
+	}
+	if (!sessionChdir(dir)) {
+		fprintf(stdout, RED "micro-bash: cd: %s: File or directory doesn't exist" RESET_COLOR "\n", dir);
+		return 0;
+	}
+	return 1;
+}
+
+
+/**************************************************************************************************************************
+Write the character of the escape sequence starting after '\' in s (\n \t \\ \a \b \r \v \e \0nnn).
+Return the number of chars of s used (0 if it isn't an escape sequence)
+**************************************************************************************************************************/
+static int putEscape(const char *s)
+{
+	const char *from = "ntabrve\\", *to = "\n\t\a\b\r\v\x1b\\";
+	const char *p;
+	int c = 0, n = 1;
+	if (*s == '0') {	// octal
+		while (n < 4 && s[n] >= '0' && s[n] <= '7')
+			c = c * 8 + s[n++] - '0';
+		putchar(c);
+		return n;
+	}
+	if (*s == '\0' || (p = strchr(from, *s)) == NULL)
+		return 0;
+	putchar(to[p - from]);
+	return 1;
+}
+
+
+/**************************************************************************************************************************
+Write the string, with -e the escape sequences are replaced
+**************************************************************************************************************************/
+static void putEscaped(const char *s, unsigned int escapes)
+{
+	int n;
+	if (!escapes) {
+		fputs(s, stdout);
+		return;
+	}
+	for (; *s; s++) {
+		if (*s == '\\' && (n = putEscape(s + 1)) > 0)
+			s += n;
+		else
+			putchar(*s);
+	}
+}
+
+
+/**************************************************************************************************************************
+Build in echo command: echo [-n] [-e|-E] args...
+Return 0 if there is an error, else 1.
+**************************************************************************************************************************/
+static unsigned int echoBuiltin(char **args, int num_arg, int fd_in, int fd_out)
+{
+	unsigned int newline = 1, escapes = 0;
+	int i = 1;
+	(void)fd_in;
+	(void)fd_out;
+	for (; i < num_arg && args[i][0] == '-' && args[i][1] != '\0' && strspn(args[i] + 1, "neE") == strlen(args[i] + 1); i++)
+		for (char *o = args[i] + 1; *o; o++) {	// options
+			if (*o == 'n')
+				newline = 0;
+			else
+				escapes = *o == 'e';
+		}
+	for (; i < num_arg; i++) {
+		putEscaped(args[i], escapes);
+		if (i < num_arg - 1)
+			putchar(' ');
+	}
+	if (newline)
+		putchar('\n');
+	return fflush(stdout) == 0;
+}
+
+
+/**************************************************************************************************************************
+Build in pwd command, the directory saved by cd.
+Return 0 if there is an error, else 1.
+**************************************************************************************************************************/
+static unsigned int pwdBuiltin(char **args, int num_arg, int fd_in, int fd_out)
+{
+	(void)args;
+	(void)num_arg;
+	(void)fd_in;
+	(void)fd_out;
+	if (shell.cwd == NULL) {	// directory removed at the start
+		fprintf(stdout, RED "micro-bash: pwd: current directory doesn't exist" RESET_COLOR "\n");
+		return 0;
+	}
+	fprintf(stdout, "%s\n", shell.cwd);
+	return fflush(stdout) == 0;
+}
+
+
+/**************************************************************************************************************************
+Build in true command.
+Return 1
+**************************************************************************************************************************/
+static unsigned int trueBuiltin(char **args, int num_arg, int fd_in, int fd_out)
+{
+	(void)args;
+	(void)num_arg;
+	(void)fd_in;
+	(void)fd_out;
+	return 1;
+}
+
+
+/**************************************************************************************************************************
+Build in false command.
+Return 0
+**************************************************************************************************************************/
+static unsigned int falseBuiltin(char **args, int num_arg, int fd_in, int fd_out)
+{
+	(void)args;
+	(void)num_arg;
+	(void)fd_in;
+	(void)fd_out;
+	return 0;
+}
+
+
+/**************************************************************************************************************************
+Build in printf command: printf format [args...]
+Conversions %d %i %u %o %x %X %c %s %b %e %f %g %% with flags, width and precision, and the escape sequences of echo -e.
+The format is used again while there are arguments.
+Return 0 if there is an error, else 1.
+**************************************************************************************************************************/
+static unsigned int printfBuiltin(char **args, int num_arg, int fd_in, int fd_out)
+{
+	char spec[64];
+	const char *f;
+	int next = 2, n;
+	unsigned int ok = 1;
+	(void)fd_in;
+	(void)fd_out;
+	if (num_arg < 2) {
+		fprintf(stdout, RED "micro-bash: printf: usage: printf format [arguments]" RESET_COLOR "\n");
+		return 0;
+	}
+	do {
+		int first = next;
+		for (f = args[1]; *f; f++) {
+			if (*f == '\\' && (n = putEscape(f + 1)) > 0) {
+				f += n;
+				continue;
+			}
+			if (*f != '%') {
+				putchar(*f);
+				continue;
+			}
+			if (f[1] == '%') {
+				putchar('%');
+				f++;
+				continue;
+			}
+			// copy "%[flags][width][.precision]" in spec
+			size_t len = 1 + strspn(f + 1, "-+ #0") ;
+			len += strspn(f + len, "0123456789");
+			if (f[len] == '.')
+				len += 1 + strspn(f + len + 1, "0123456789");
+			if (f[len] == '\0' || len > sizeof(spec) - 4) {	// bad conversion, written as it is
+				fputs(f, stdout);
+				break;
+			}
+			const char *arg = next < num_arg ? args[next++] : "";
+			char conv = f[len];
+			memcpy(spec, f, len);
+			f += len;
+			if (strchr("diouxX", conv) != NULL) {	// integer conversions with "ll"
+				char *end;
+				errno = 0;
+				spec[len] = 'l';
+				spec[len + 1] = 'l';
+				spec[len + 2] = conv;
+				spec[len + 3] = '\0';
+				if (conv == 'd' || conv == 'i')
+					printf(spec, strtoll(arg, &end, 0));
+				else
+					printf(spec, strtoull(arg, &end, 0));
+				if (*end != '\0' || errno != 0) {
+					fprintf(stderr, "micro-bash: printf: %s: invalid number\n", arg);
+					ok = 0;
+				}
+				continue;
+			}
+			spec[len] = conv;
+			spec[len + 1] = '\0';
+			if (strchr("eEfFgG", conv) != NULL)
+				printf(spec, strtod(arg, NULL));
+			else if (conv == 'c')
+				printf(spec, arg[0]);
+			else if (conv == 's')
+				printf(spec, arg);
+			else if (conv == 'b')
+				putEscaped(arg, 1);
+			else {
+				fputs(spec, stdout);
+				next--;
+			}
+		}
+		if (next == first)	// no conversions: the format is not used again
+			break;
+	} while (next < num_arg);
+	return fflush(stdout) == 0 && ok;
+}
+
+
+/**************************************************************************************************************************
+Build in export command:
+ - export			print the exported variables;
+ - export name[=value]...	set the variables and add them to the environment of the commands.
+Return 0 if there is an error, else 1.
+**************************************************************************************************************************/
+static unsigned int exportBuiltin(char **args, int num_arg, int fd_in, int fd_out)
+{
+	unsigned int ok = 1;
+	(void)fd_in;
+	(void)fd_out;
+	if (num_arg == 1 || (num_arg == 2 && strcmp(args[1], "-p") == 0)) {
+		for (char **e = exportedEnv(); e != NULL && *e != NULL; e++)
+			fprintf(stdout, "export %s\n", *e);
+		return fflush(stdout) == 0;
+	}
+	for (int i = 1; i < num_arg; i++) {
+		size_t len = nameLength(args[i]);
+		if (len == 0 || (args[i][len] != '=' && args[i][len] != '\0')) {
+			fprintf(stdout, RED "micro-bash: export: `%s': not a valid identifier" RESET_COLOR "\n", args[i]);
+			ok = 0;
+		} else if (args[i][len] == '=')
+			ok = assignVar(args[i], VAR_EXPORT) && ok;
+		else if (!exportVar(args[i]))	// not set: exported with an empty value
+			ok = setVar(args[i], "", VAR_EXPORT) && ok;
+	}
+	return ok;
+}
+
+
+/**************************************************************************************************************************
+Build in unset command: unset name...
+Return 0 if there is an error, else 1.
+**************************************************************************************************************************/
+static unsigned int unsetBuiltin(char **args, int num_arg, int fd_in, int fd_out)
+{
+	unsigned int ok = 1;
+	(void)fd_in;
+	(void)fd_out;
+	for (int i = 1; i < num_arg; i++)
+		if (!unsetVar(args[i])) {
+			fprintf(stdout, RED "micro-bash: unset: `%s': not a valid identifier" RESET_COLOR "\n", args[i]);
+			ok = 0;
+		}
+	return ok;
+}
+
+
+/**************************************************************************************************************************
+Table of the build in commands
+**************************************************************************************************************************/
+static const builtin builtins[] = {
+	{ "cd", cdBuiltin, BUILTIN_ALONE | BUILTIN_NOREDIR },
+	{ "hash", hashBuiltin, BUILTIN_ALONE },
+	{ "jobs", jobsBuiltin, BUILTIN_ALONE },
+	{ "wait", waitBuiltin, BUILTIN_ALONE | BUILTIN_NOREDIR },
+	{ "fg", fgBuiltin, BUILTIN_ALONE | BUILTIN_NOREDIR },
+	{ "export", exportBuiltin, 0 },
+	{ "unset", unsetBuiltin, BUILTIN_ALONE },
+	{ "history", historyBuiltin, 0 },
+	{ "parallel", parallelBuiltin, BUILTIN_LAST | BUILTIN_FDS },
+	{ "cat", catBuiltin, BUILTIN_FDS | BUILTIN_PLAIN },
+	{ "tee", teeBuiltin, BUILTIN_FDS | BUILTIN_PLAIN },
+	{ "echo", echoBuiltin, 0 },
+	{ "printf", printfBuiltin, 0 },
+	{ "pwd", pwdBuiltin, 0 },
+	{ "true", trueBuiltin, 0 },
+	{ "false", falseBuiltin, 0 },
+	{ NULL, NULL, 0 }
+};
+
+
+/**************************************************************************************************************************
+Search the command in the table of the build in commands.
+Return NULL if it isn't a build in command (or it has options of the real one), else the build in
+**************************************************************************************************************************/
+const builtin *findBuiltin(const command * cmd)
+{
+	const builtin *b;
+	for (b = builtins; b->name != NULL && strcmp(b->name, cmd->argv[0]) != 0; b++)
+		;
+	if (b->name == NULL)
+		return NULL;
+	if (b->flags & BUILTIN_PLAIN)	// options only of the real command ("-" is stdin, "tee -a" is known)
+		for (int i = 1; i < cmd->argc; i++)
+			if (cmd->argv[i][0] == '-' && cmd->argv[i][1] != '\0'
+			    && !(i == 1 && strcmp(b->name, "tee") == 0 && strcmp(cmd->argv[i], "-a") == 0))
+				return NULL;
+	return b;
+}
+
+
+/**************************************************************************************************************************
+Execute the build in command inside the shell with fd_in and fd_out (-2 for stdin and stdout), lastStatus is its exit
+status. SIGPIPE is blocked, so when the reader of a pipe ends the command fails with EPIPE (exit status 1) without
+killing the shell; the children get their mask back (see childSigmask).
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+unsigned int execBuiltin(const builtin * b, const command * cmd, int fd_in, int fd_out)
+{
+	sigset_t pipeSet, saved;
+	struct timespec zero = { 0, 0 };
+	int stdout_safe = -1, broken = 0;
+	unsigned int ok;
+	sigemptyset(&pipeSet);
+	sigaddset(&pipeSet, SIGPIPE);
+	sigprocmask(SIG_BLOCK, &pipeSet, &saved);
+	fflush(stdout);
+	if (fd_out >= 0 && !(b->flags & BUILTIN_FDS)) {	// stdout of the shell on fd_out
+		stdout_safe = dup(STDOUT_FILENO);
+		dup2(fd_out, STDOUT_FILENO);
+	}
+	lastStatus = 0;
+	ok = b->run(cmd->argv, cmd->argc, fd_in, fd_out);
+	if (!ok && lastStatus == 0)
+		lastStatus = EXIT_FAILURE;
+	if (stdout_safe >= 0) {	// reset stdout
+		fflush(stdout);
+		dup2(stdout_safe, STDOUT_FILENO);
+		close(stdout_safe);
+	}
+	clearerr(stdout);
+	while (sigtimedwait(&pipeSet, NULL, &zero) > 0)	// discard SIGPIPE
+		broken = 1;
+	sigprocmask(SIG_SETMASK, &saved, NULL);
+	if (broken) {	// EPIPE: the reader has ended before the output
+		lastStatus = EXIT_FAILURE;
+		ok = 0;
+	}
+	return ok;
+}
+
+
+/**************************************************************************************************************************
+Execute the build in command in a child (command of a pipe or in background) with fd_in as stdin and fd_out as stdout,
+the child closes the n_close descriptors of fds_close and applies the scheduling sched (NULL to keep the one of the
+shell).
+Return -1 if there is an error, else the pid of the child
+**************************************************************************************************************************/
+pid_t forkBuiltin(const builtin * b, const command * cmd, int fd_in, int fd_out, const int *fds_close, int n_close,
+		  const stageSched * sched)
+{
+	pid_t pid;
+	unsigned int ok;
+	fflush(stdout);	// nothing buffered has to be written twice
+	if ((pid = fork()) != 0)
+		return pid;	// father process or fork error
+	// child process
+	childSigmask();
+	applySched(sched);
+	if (fd_in >= 0 && dup2(fd_in, STDIN_FILENO) == -1)	// redirect input
+		_exit(EXIT_FAILURE);
+	if (fd_out >= 0 && dup2(fd_out, STDOUT_FILENO) == -1)	// redirect output
+		_exit(EXIT_FAILURE);
+	for (int i = 0; i < n_close; i++)	// close all file descriptor
+		if (fds_close[i] > STDERR_FILENO)
+			close(fds_close[i]);
+	if (fd_in > STDERR_FILENO)
+		close(fd_in);
+	if (fd_out > STDERR_FILENO)
+		close(fd_out);
+	lastStatus = 0;
+	ok = b->run(cmd->argv, cmd->argc, -2, -2);
+	fflush(stdout);
+	_exit(!ok && lastStatus == 0 ? EXIT_FAILURE : lastStatus);
+}
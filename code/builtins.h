@@ -0,0 +1,51 @@
+#ifndef BUILTINS_H
+#define BUILTINS_H
+
+#include <sys/types.h>
+#include "parsing.h"
+#include "cpusched.h"
+
+#define BUILTIN_ALONE 1		// changes the shell: no pipes and no "&"
+#define BUILTIN_NOREDIR 2	// doesn't accept "<" and ">"
+#define BUILTIN_FDS 4		// reads fd_in and writes fd_out itself, else stdout is moved on fd_out
+#define BUILTIN_PLAIN 8		// only without options, else the real command is executed
+#define BUILTIN_LAST 16		// waits its own children in the shell: only as the last command of a pipe, no "&"
+
+
+/**************************************************************************************************************************
+Build in command: name, function and flags.
+The function takes arguments, number of arguments, fd_in and fd_out (-2 if there isn't the redirection).
+Return 0 if there is an error, else 1 (lastStatus can be set for other exit statuses)
+**************************************************************************************************************************/
+typedef struct {
+	const char *name;
+	unsigned int (*run)(char **, int, int, int);
+	unsigned int flags;
+} builtin;
+
+
+/**************************************************************************************************************************
+Search the command in the table of the build in commands.
+Return NULL if it isn't a build in command (or it has options of the real one), else the build in
+**************************************************************************************************************************/
+const builtin *findBuiltin(const command *);
+
+
+/**************************************************************************************************************************
+Execute the build in command inside the shell with fd_in and fd_out (-2 for stdin and stdout), lastStatus is its exit
+status. SIGPIPE is blocked, so when the reader of a pipe ends the command fails with EPIPE (exit status 1) without
+killing the shell; the children get their mask back (see childSigmask).
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+unsigned int execBuiltin(const builtin *, const command *, int, int);
+
+
+/**************************************************************************************************************************
+Execute the build in command in a child (command of a pipe or in background) with fd_in as stdin and fd_out as stdout,
+the child closes the n_close descriptors of fds_close and applies the scheduling sched (NULL to keep the one of the
+shell).
+Return -1 if there is an error, else the pid of the child
+**************************************************************************************************************************/
+pid_t forkBuiltin(const builtin *, const command *, int, int, const int *, int, const stageSched *);
+
+#endif
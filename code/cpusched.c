@@ -0,0 +1,260 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include "cpusched.h"
+#include "variables.h"
+
+#define IOPRIO_CLASS_SHIFT 13	// ioprio_set values, as in linux/ioprio.h
+#define IOPRIO_CLASS_RT 1
+#define IOPRIO_CLASS_BE 2
+#define IOPRIO_CLASS_IDLE 3
+#define IOPRIO_WHO_PROCESS 1
+
+static int *cpuOrder = NULL, nCpus = -1;	// CPUs of the shell, one per core first (-1 until read)
+static cpu_set_t *nodes = NULL;	// CPUs of the shell in each NUMA node with some of them
+static int nNodes = 0;
+
+
+/**************************************************************************************************************************
+Read a list of CPUs (example 0-3,6) in the set.
+Return 0 if it isn't a list, else 1
+**************************************************************************************************************************/
+static unsigned int parseCpuList(const char *s, cpu_set_t *set)
+{
+	char *end;
+	long first, last;
+	CPU_ZERO(set);
+	while (1) {
+		first = last = strtol(s, &end, 10);
+		if (end == s || first < 0 || first >= CPU_SETSIZE)
+			return 0;
+		if (*end == '-') {
+			s = end + 1;
+			last = strtol(s, &end, 10);
+			if (end == s || last < first || last >= CPU_SETSIZE)
+				return 0;
+		}
+		for (long c = first; c <= last; c++)
+			CPU_SET(c, set);
+		if (*end == '\0' || *end == '\n')
+			return 1;
+		if (*end != ',')
+			return 0;
+		s = end + 1;
+	}
+}
+
+
+/**************************************************************************************************************************
+Read the first line of a file of /sys in buf.
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+static unsigned int readSys(const char *path, char *buf, int dim)
+{
+	FILE *f;
+	unsigned int ok;
+	if ((f = fopen(path, "re")) == NULL)
+		return 0;
+	ok = fgets(buf, dim, f) != NULL;
+	fclose(f);
+	return ok;
+}
+
+
+/**************************************************************************************************************************
+Read once the CPUs allowed to the shell, the first thread of each core before the other threads of the cores
+(hyper-threading), so the stages of CPUS=auto get different cores while there are, and the CPUs of the NUMA nodes.
+**************************************************************************************************************************/
+static void readTopology()
+{
+	cpu_set_t allowed, set;
+	char path[96], buf[4096];
+	int first, maxNode = -1, node;
+	DIR *dir;
+	struct dirent *d;
+	if (nCpus >= 0)
+		return;
+	nCpus = 0;
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) == -1
+	    || (cpuOrder = malloc(sizeof(int) * CPU_COUNT(&allowed))) == NULL)
+		return;
+	for (int pass = 0; pass < 2; pass++)	// first threads of the cores, then the others
+		for (int c = 0; c < CPU_SETSIZE; c++) {
+			if (!CPU_ISSET(c, &allowed))
+				continue;
+			snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", c);
+			first = readSys(path, buf, sizeof(buf)) ? atoi(buf) : c;
+			if ((first == c) == (pass == 0))
+				cpuOrder[nCpus++] = c;
+		}
+	if ((dir = opendir("/sys/devices/system/node")) == NULL)	// kernel without NUMA
+		return;
+	while ((d = readdir(dir)) != NULL)
+		if (sscanf(d->d_name, "node%d", &node) == 1 && node > maxNode)
+			maxNode = node;
+	closedir(dir);
+	if (maxNode < 0 || (nodes = malloc(sizeof(cpu_set_t) * (maxNode + 1))) == NULL)
+		return;
+	for (node = 0; node <= maxNode; node++) {	// in the order of the nodes
+		snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+		if (!readSys(path, buf, sizeof(buf)) || !parseCpuList(buf, &set))
+			continue;
+		CPU_AND(&nodes[nNodes], &set, &allowed);
+		if (CPU_COUNT(&nodes[nNodes]) > 0)
+			nNodes++;
+	}
+}
+
+
+/**************************************************************************************************************************
+Nice level of the shell changed by inc, between -20 and 19
+**************************************************************************************************************************/
+static int niceLevel(long inc)
+{
+	long level = getpriority(PRIO_PROCESS, 0) + inc;
+	return level < -20 ? -20 : level > 19 ? 19 : (int)level;
+}
+
+
+/**************************************************************************************************************************
+Read an I/O priority: idle, be[:0-7] or rt[:0-7] (level 4 if it's missing).
+Return 0 if it's wrong, else 1
+**************************************************************************************************************************/
+static unsigned int parseIoprio(const char *value, int *ioprio)
+{
+	int class, level = 4;
+	if (strcmp(value, "idle") == 0) {
+		*ioprio = IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT;
+		return 1;
+	}
+	if (strncmp(value, "be", 2) == 0)
+		class = IOPRIO_CLASS_BE;
+	else if (strncmp(value, "rt", 2) == 0)
+		class = IOPRIO_CLASS_RT;
+	else
+		return 0;
+	if (value[2] == ':' && value[3] >= '0' && value[3] <= '7' && value[4] == '\0')
+		level = value[3] - '0';
+	else if (value[2] != '\0')
+		return 0;
+	*ioprio = class << IOPRIO_CLASS_SHIFT | level;
+	return 1;
+}
+
+
+/**************************************************************************************************************************
+Read the setting name=value (CPUS, NICE or IOPRIO) in st, the mode of CPUS in mode.
+Return 0 if the value is wrong (st doesn't change), else 1
+**************************************************************************************************************************/
+static unsigned int parseSetting(const char *name, const char *value, stageSched * st, unsigned int *mode)
+{
+	char *end;
+	long n;
+	if (value[0] == '\0')	// empty as unset
+		return 1;
+	if (strcmp(name, "CPUS") == 0) {
+		if (strcmp(value, "auto") == 0)
+			*mode = CPUS_AUTO;
+		else if (strcmp(value, "numa") == 0)
+			*mode = CPUS_NUMA;
+		else if (parseCpuList(value, &st->cpus)) {
+			*mode = CPUS_LIST;
+			st->set |= SCHED_CPUS;
+		} else {
+			fprintf(stdout, RED "micro-bash: CPUS: %s: not a list of CPUs, auto or numa" RESET_COLOR "\n", value);
+			return 0;
+		}
+	} else if (strcmp(name, "NICE") == 0) {
+		n = strtol(value, &end, 10);
+		if (end == value || *end != '\0' || n < -20 || n > 19) {
+			fprintf(stdout, RED "micro-bash: NICE: %s: not an increment between -20 and 19" RESET_COLOR "\n", value);
+			return 0;
+		}
+		st->nice = niceLevel(n);
+		st->set |= SCHED_NICE;
+	} else if (parseIoprio(value, &st->ioprio))
+		st->set |= SCHED_IOPRIO;
+	else {
+		fprintf(stdout, RED "micro-bash: IOPRIO: %s: not idle, be[:0-7] or rt[:0-7]" RESET_COLOR "\n", value);
+		return 0;
+	}
+	return 1;
+}
+
+
+/**************************************************************************************************************************
+Read CPUS, NICE and IOPRIO for a command line.
+Return 0 if a value is wrong (it's ignored), else 1
+**************************************************************************************************************************/
+unsigned int initLineSched(lineSched * ls)
+{
+	static const char *names[] = { "CPUS", "NICE", "IOPRIO" };
+	const char *value;
+	unsigned int ok = 1;
+	ls->cpuMode = CPUS_NONE;
+	ls->line.set = 0;
+	for (int i = 0; i < 3; i++)
+		if ((value = getVar(names[i])) != NULL)
+			ok &= parseSetting(names[i], value, &ls->line, &ls->cpuMode);
+	if (ls->cpuMode != CPUS_LIST)	// the CPUs of the automatic modes change with the stage
+		ls->line.set &= ~SCHED_CPUS;
+	return ok;
+}
+
+
+/**************************************************************************************************************************
+Scheduling of the stage i of n, command cmd: settings of the line, CPUs of the automatic modes and the assignments of
+the stage, written in st. In numa mode the stages are split in consecutive groups, one per node, so only the pipes
+between two groups cross the nodes.
+Return NULL if the stage keeps the scheduling of the shell, else st
+**************************************************************************************************************************/
+const stageSched *stageSchedule(const lineSched * ls, int i, int n, const command * cmd, stageSched * st)
+{
+	static const char *names[] = { "CPUS", "NICE", "IOPRIO" };
+	unsigned int mode = ls->cpuMode;
+	size_t len;
+	if (mode == CPUS_NONE && ls->line.set == 0 && cmd->n_assign == 0)	// nothing to change, the usual case
+		return NULL;
+	*st = ls->line;
+	for (int j = 0; j < cmd->n_assign; j++)
+		for (int k = 0; k < 3; k++) {
+			len = strlen(names[k]);
+			if (strncmp(cmd->assign[j], names[k], len) == 0 && cmd->assign[j][len] == '=')
+				parseSetting(names[k], cmd->assign[j] + len + 1, st, &mode);
+		}
+	if (mode == CPUS_AUTO || mode == CPUS_NUMA) {
+		readTopology();
+		if (mode == CPUS_AUTO && nCpus > 0) {
+			CPU_ZERO(&st->cpus);
+			CPU_SET(cpuOrder[i % nCpus], &st->cpus);
+			st->set |= SCHED_CPUS;
+		} else if (mode == CPUS_NUMA && nNodes > 1) {
+			st->cpus = nodes[(long)i * nNodes / n];
+			st->set |= SCHED_CPUS;
+		}
+	}
+	return st->set != 0 ? st : NULL;
+}
+
+
+/**************************************************************************************************************************
+Apply the scheduling in the child before exec (only system calls, it can run in a vfork child). A setting refused by
+the kernel is skipped, the command runs anyway.
+**************************************************************************************************************************/
+void applySched(const stageSched * st)
+{
+	if (st == NULL)
+		return;
+	if (st->set & SCHED_CPUS)
+		sched_setaffinity(0, sizeof(cpu_set_t), &st->cpus);
+	if (st->set & SCHED_NICE)
+		setpriority(PRIO_PROCESS, 0, st->nice);
+	if (st->set & SCHED_IOPRIO)
+		syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, st->ioprio);
+}
@@ -0,0 +1,62 @@
+#ifndef CPUSCHED_H
+#define CPUSCHED_H
+
+#include <sched.h>
+#include "parsing.h"
+
+#define SCHED_CPUS 1	// the child sets its CPU affinity
+#define SCHED_NICE 2	// the child sets its nice level
+#define SCHED_IOPRIO 4	// the child sets its I/O priority
+
+#define CPUS_NONE 0	// CPUs of the shell
+#define CPUS_LIST 1	// the same list of CPUs for all the stages
+#define CPUS_AUTO 2	// each stage on its own core
+#define CPUS_NUMA 3	// the stages spread over the NUMA nodes, each one on all the CPUs of its node
+
+
+/**************************************************************************************************************************
+Scheduling of a command, applied by the child before exec (set is 0 if nothing changes)
+**************************************************************************************************************************/
+typedef struct {
+	unsigned int set;	// SCHED_CPUS, SCHED_NICE, SCHED_IOPRIO
+	cpu_set_t cpus;
+	int nice;		// absolute nice level
+	int ioprio;		// class and level, as ioprio_set wants them
+} stageSched;
+
+
+/**************************************************************************************************************************
+Scheduling of a command line, chosen with the shell variables (a stage overrides them with NAME=value before its
+command, example CPUS=3 sort | NICE=10 gzip):
+ - CPUS: list of CPUs (0-3,6), "auto" (each stage on its own core) or "numa" (stages spread over the NUMA nodes);
+ - NICE: increment of the nice level of the commands (-20..19, a negative one needs privileges);
+ - IOPRIO: I/O priority, "idle", "be[:0-7]" (best effort) or "rt[:0-7]" (real time, needs privileges).
+**************************************************************************************************************************/
+typedef struct {
+	unsigned int cpuMode;	// CPUS_NONE, CPUS_LIST, CPUS_AUTO, CPUS_NUMA
+	stageSched line;	// settings of all the stages (the CPUs only in CPUS_LIST mode)
+} lineSched;
+
+
+/**************************************************************************************************************************
+Read CPUS, NICE and IOPRIO for a command line.
+Return 0 if a value is wrong (it's ignored), else 1
+**************************************************************************************************************************/
+unsigned int initLineSched(lineSched *);
+
+
+/**************************************************************************************************************************
+Scheduling of the stage i of n, command cmd: settings of the line, CPUs of the automatic modes and the assignments of
+the stage, written in st.
+Return NULL if the stage keeps the scheduling of the shell, else st
+**************************************************************************************************************************/
+const stageSched *stageSchedule(const lineSched *, int, int, const command *, stageSched *);
+
+
+/**************************************************************************************************************************
+Apply the scheduling in the child before exec (only system calls, it can run in a vfork child). A setting refused by
+the kernel is skipped, the command runs anyway.
+**************************************************************************************************************************/
+void applySched(const stageSched *);
+
+#endif
@@ -0,0 +1,382 @@
+#define _GNU_SOURCE
+
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "history.h"
+#include "parsing.h"
+#include "variables.h"
+
+#define MININDEXDIM 4096	// initial number of slots of the trigram index, always a power of 2
+#define TAILSIZE 4096		// bytes read from the end of the file for its last line
+
+
+/**************************************************************************************************************************
+Entry of the history: a line of the file read in fileText (not ending with '\0') or a line of this session
+**************************************************************************************************************************/
+typedef struct {
+	const char *text;
+	size_t len;
+} histEntry;
+
+
+/**************************************************************************************************************************
+Slot of the trigram index: the trigram (+1, 0 is a free slot) and the growing list of the entries that contain it
+**************************************************************************************************************************/
+typedef struct {
+	unsigned int key;
+	int *ids;
+	int n, dim;
+} posting;
+
+static int histFd = -1;
+static char *fileText = NULL;		// lines of the file when it's loaded
+static size_t fileLen = 0;		// size of the file when the shell started
+static histEntry *entries = NULL;	// lines of the file, then of this session
+static int nEntries = 0, entriesDim = 0;
+static unsigned int loaded = 0;		// 1 when the file is read and split in lines
+static posting *trigramIndex = NULL;
+static unsigned int indexDim = 0, indexUsed = 0;
+static int indexed = 0;			// entries in the index
+
+
+/**************************************************************************************************************************
+Open the file of the history (HISTFILE or ~/.ubash_history), the lines are read only when the history is used, so the
+start doesn't depend on the size of the file.
+Return 0 if there is an error (the history is kept only in memory), else 1
+**************************************************************************************************************************/
+unsigned int initHistory()
+{
+	const char *file = getVar("HISTFILE"), *home = getVar("HOME");
+	char *path = NULL;
+	struct stat st;
+	if (file == NULL || file[0] == '\0') {
+		if (home == NULL || asprintf(&path, "%s/%s", home, HISTFILE) == -1)
+			return 0;
+		file = path;
+	}
+	histFd = open(file, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+	free(path);
+	if (histFd == -1 || fstat(histFd, &st) == -1)
+		return 0;
+	fileLen = st.st_size;
+	return 1;
+}
+
+
+/**************************************************************************************************************************
+Add the entry to the list.
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+static unsigned int pushEntry(const char *text, size_t len)
+{
+	if (nEntries == entriesDim) {
+		histEntry *newEntries;
+		int newDim = entriesDim == 0 ? 1024 : entriesDim * 2;
+		if ((newEntries = realloc(entries, sizeof(histEntry) * newDim)) == NULL)
+			return 0;
+		entries = newEntries;
+		entriesDim = newDim;
+	}
+	entries[nEntries].text = text;
+	entries[nEntries++].len = len;
+	return 1;
+}
+
+
+/**************************************************************************************************************************
+Read the file in memory (not mapped: another shell can shrink it with history -c) and split it in lines before the
+entries of this session, only the first time. The lines written by this session after the start aren't read again.
+**************************************************************************************************************************/
+static void loadHistory()
+{
+	histEntry *session;
+	int nSession = nEntries;
+	ssize_t n;
+	const char *s, *end, *nl;
+	if (loaded)
+		return;
+	loaded = 1;
+	if (histFd == -1 || fileLen == 0 || (fileText = malloc(fileLen)) == NULL)
+		return;
+	if ((n = pread(histFd, fileText, fileLen, 0)) <= 0) {	// also shorter if the file was cleared meanwhile
+		free(fileText);
+		fileText = NULL;
+		fileLen = 0;
+		return;
+	}
+	fileLen = n;
+	s = fileText;
+	end = fileText + fileLen;
+	session = entries;	// lines added before the load
+	entries = NULL;
+	nEntries = entriesDim = 0;
+	while (s < end) {
+		if ((nl = memchr(s, '\n', end - s)) == NULL)
+			nl = end;
+		if (nl > s)	// empty lines are skipped
+			pushEntry(s, nl - s);
+		s = nl + 1;
+	}
+	for (int i = 0; i < nSession; i++)
+		pushEntry(session[i].text, session[i].len);
+	free(session);
+}
+
+
+/**************************************************************************************************************************
+Close the file of the history, free the entries, the lines of the file and the index
+**************************************************************************************************************************/
+void freeHistory()
+{
+	for (int i = 0; i < nEntries; i++)	// lines of this session
+		if (entries[i].text < fileText || entries[i].text >= fileText + fileLen)
+			free((char *)entries[i].text);
+	for (unsigned int i = 0; i < indexDim; i++)
+		free(trigramIndex[i].ids);
+	free(entries);
+	free(trigramIndex);
+	free(fileText);
+	if (histFd != -1)
+		close(histFd);
+	entries = NULL;
+	trigramIndex = NULL;
+	fileText = NULL;
+	nEntries = entriesDim = indexed = 0;
+	indexDim = indexUsed = fileLen = loaded = 0;
+	histFd = -1;
+}
+
+
+/**************************************************************************************************************************
+Return the last line of the history (len 0 if it's empty) without reading all the file: only its end is read, all the
+file if the last line is longer
+**************************************************************************************************************************/
+static const char *lastEntry(size_t *len)
+{
+	static char tail[TAILSIZE];
+	off_t off = fileLen > TAILSIZE ? (off_t)(fileLen - TAILSIZE) : 0;
+	const char *end, *start;
+	ssize_t n;
+	if (nEntries == 0 && !loaded && histFd != -1 && fileLen > 0) {
+		if ((n = pread(histFd, tail, fileLen - off, off)) < 0)
+			n = 0;
+		for (end = tail + n; end > tail && end[-1] == '\n'; end--)
+			;
+		start = end > tail ? memrchr(tail, '\n', end - tail) : NULL;
+		if (start != NULL || off == 0 || n < (ssize_t)(fileLen - off)) {	// the whole line, or the file has shrunk
+			start = start != NULL ? start + 1 : tail;
+			*len = end - start;
+			return start;
+		}
+		loadHistory();	// a line longer than the tail
+	}
+	*len = nEntries > 0 ? entries[nEntries - 1].len : 0;
+	return nEntries > 0 ? entries[nEntries - 1].text : NULL;
+}
+
+
+/**************************************************************************************************************************
+Return the slot of the trigram in the index (free slot if it isn't there), linear probing
+**************************************************************************************************************************/
+static posting *findTrigram(posting *t, unsigned int dim, unsigned int key)
+{
+	unsigned int i = (key * 2654435761u) & (dim - 1);
+	while (t[i].key != 0 && t[i].key != key)
+		i = (i + 1) & (dim - 1);
+	return &t[i];
+}
+
+
+/**************************************************************************************************************************
+Double the index when it is more than half full.
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+static unsigned int growIndex()
+{
+	posting *newIndex;
+	unsigned int newDim = indexDim == 0 ? MININDEXDIM : indexDim * 2;
+	if ((newIndex = calloc(newDim, sizeof(posting))) == NULL)
+		return 0;
+	for (unsigned int i = 0; i < indexDim; i++)
+		if (trigramIndex[i].key != 0)
+			*findTrigram(newIndex, newDim, trigramIndex[i].key) = trigramIndex[i];
+	free(trigramIndex);
+	trigramIndex = newIndex;
+	indexDim = newDim;
+	return 1;
+}
+
+
+/**************************************************************************************************************************
+Key of the trigram at s
+**************************************************************************************************************************/
+static unsigned int trigram(const char *s)
+{
+	return ((unsigned char)s[0] << 16 | (unsigned char)s[1] << 8 | (unsigned char)s[2]) + 1;
+}
+
+
+/**************************************************************************************************************************
+Add the trigrams of the entry id to the index.
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+static unsigned int indexEntry(int id)
+{
+	const histEntry *e = &entries[id];
+	posting *p;
+	for (size_t i = 0; i + 3 <= e->len; i++) {
+		if (2 * (indexUsed + 1) > indexDim && !growIndex())
+			return 0;
+		p = findTrigram(trigramIndex, indexDim, trigram(e->text + i));
+		if (p->key == 0) {
+			p->key = trigram(e->text + i);
+			indexUsed++;
+		}
+		if (p->n > 0 && p->ids[p->n - 1] == id)	// trigram already seen in the entry
+			continue;
+		if (p->n == p->dim) {
+			int *newIds, newDim = p->dim == 0 ? 4 : p->dim * 2;
+			if ((newIds = realloc(p->ids, sizeof(int) * newDim)) == NULL)
+				return 0;
+			p->ids = newIds;
+			p->dim = newDim;
+		}
+		p->ids[p->n++] = id;
+	}
+	return 1;
+}
+
+
+/**************************************************************************************************************************
+Append the command line (without '\n') to the history and to its file, the same line twice in a row is saved once
+**************************************************************************************************************************/
+void addHistory(const char *line)
+{
+	size_t len = strlen(line), lastLen;
+	const char *last = lastEntry(&lastLen);
+	char *copy;
+	if (len == 0 || (last != NULL && lastLen == len && memcmp(last, line, len) == 0))
+		return;
+	if ((copy = strdup(line)) == NULL || !pushEntry(copy, len)) {
+		free(copy);
+		return;
+	}
+	if (histFd != -1) {	// one write, so the lines of two shells are not mixed
+		struct iovec iov[2] = { { copy, len }, { "\n", 1 } };
+		if (writev(histFd, iov, 2) == -1)
+			perror("micro-bash: history");
+	}
+	if (indexed == nEntries - 1 && trigramIndex != NULL)	// the index is kept updated once built
+		indexed += indexEntry(nEntries - 1);
+}
+
+
+/**************************************************************************************************************************
+Return the number of entries of the history
+**************************************************************************************************************************/
+int historyCount()
+{
+	loadHistory();
+	return nEntries;
+}
+
+
+/**************************************************************************************************************************
+Return the entry i of the history (0 is the oldest) and its length in len, it doesn't end with '\0'
+**************************************************************************************************************************/
+const char *historyEntry(int i, size_t *len)
+{
+	loadHistory();
+	*len = entries[i].len;
+	return entries[i].text;
+}
+
+
+/**************************************************************************************************************************
+Search the newest entry before from that contains the string, with a trigram index built the first time.
+Return its index, -1 if there isn't
+**************************************************************************************************************************/
+int searchHistory(const char *s, int from)
+{
+	size_t len = strlen(s);
+	posting *best = NULL, *p;
+	int lo, hi;
+	loadHistory();
+	if (from > nEntries)
+		from = nEntries;
+	if (len < 3) {	// no trigram: all the entries
+		for (int i = from - 1; i >= 0; i--)
+			if (memmem(entries[i].text, entries[i].len, s, len) != NULL)
+				return i;
+		return -1;
+	}
+	while (indexed < nEntries && indexEntry(indexed))
+		indexed++;
+	for (size_t i = 0; i + 3 <= len; i++) {	// the trigram with less entries
+		if (indexDim == 0 || (p = findTrigram(trigramIndex, indexDim, trigram(s + i)))->key == 0)
+			return -1;
+		if (best == NULL || p->n < best->n)
+			best = p;
+	}
+	for (lo = 0, hi = best->n; lo < hi;) {	// entries of the list before from
+		int mid = (lo + hi) / 2;
+		if (best->ids[mid] < from)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	while (--lo >= 0) {
+		const histEntry *e = &entries[best->ids[lo]];
+		if (memmem(e->text, e->len, s, len) != NULL)
+			return best->ids[lo];
+	}
+	return -1;
+}
+
+
+/**************************************************************************************************************************
+Build in history command:
+ - history [n]		print the last n entries (all without n);
+ - history -s string	print the entries that contain the string, with the index;
+ - history -c		clear the history and its file.
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+unsigned int historyBuiltin(char **args, int num_arg, int fd_in, int fd_out)
+{
+	int n = historyCount(), i;
+	(void)fd_in;
+	(void)fd_out;
+	if (num_arg == 2 && strcmp(args[1], "-c") == 0) {
+		if (histFd != -1 && ftruncate(histFd, 0) == -1)
+			return 0;
+		int fd = histFd;
+		histFd = -1;	// kept open
+		freeHistory();
+		histFd = fd;
+		loaded = 1;
+		return 1;
+	}
+	if (num_arg == 3 && strcmp(args[1], "-s") == 0) {
+		int *found = malloc(sizeof(int) * (n + 1)), nFound = 0;
+		if (found == NULL)
+			return 0;
+		for (i = searchHistory(args[2], n); i >= 0; i = searchHistory(args[2], i))
+			found[nFound++] = i;
+		while (nFound-- > 0)	// from the oldest
+			fprintf(stdout, "%5d  %.*s\n", found[nFound] + 1, (int)entries[found[nFound]].len, entries[found[nFound]].text);
+		free(found);
+		return fflush(stdout) == 0;
+	}
+	if (num_arg > 2 || (num_arg == 2 && atoi(args[1]) <= 0)) {
+		fprintf(stdout, RED "micro-bash: history: usage: history [n] | -s string | -c" RESET_COLOR "\n");
+		return 0;
+	}
+	for (i = num_arg == 2 && atoi(args[1]) < n ? n - atoi(args[1]) : 0; i < n; i++)
+		fprintf(stdout, "%5d  %.*s\n", i + 1, (int)entries[i].len, entries[i].text);
+	return fflush(stdout) == 0;
+}
@@ -0,0 +1,57 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stddef.h>
+
+#define HISTFILE ".ubash_history"	// file of the history in HOME, if HISTFILE isn't set
+
+
+/**************************************************************************************************************************
+Open the file of the history (HISTFILE or ~/.ubash_history), the lines are read only when the history is used, so the
+start doesn't depend on the size of the file.
+Return 0 if there is an error (the history is kept only in memory), else 1
+**************************************************************************************************************************/
+unsigned int initHistory();
+
+
+/**************************************************************************************************************************
+Close the file of the history, free the entries, the lines of the file and the index
+**************************************************************************************************************************/
+void freeHistory();
+
+
+/**************************************************************************************************************************
+Append the command line (without '\n') to the history and to its file, the same line twice in a row is saved once
+**************************************************************************************************************************/
+void addHistory(const char *);
+
+
+/**************************************************************************************************************************
+Return the number of entries of the history
+**************************************************************************************************************************/
+int historyCount();
+
+
+/**************************************************************************************************************************
+Return the entry i of the history (0 is the oldest) and its length in len, it doesn't end with '\0'
+**************************************************************************************************************************/
+const char *historyEntry(int, size_t *);
+
+
+/**************************************************************************************************************************
+Search the newest entry before from that contains the string, with a trigram index built the first time.
+Return its index, -1 if there isn't
+**************************************************************************************************************************/
+int searchHistory(const char *, int);
+
+
+/**************************************************************************************************************************
+Build in history command:
+ - history [n]		print the last n entries (all without n);
+ - history -s string	print the entries that contain the string, with the index;
+ - history -c		clear the history and its file.
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+unsigned int historyBuiltin(char **, int, int, int);
+
+#endif
@@ -0,0 +1,266 @@
+#define _GNU_SOURCE
+
+#include <signal.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include "jobs.h"
+#include "parsing.h"
+
+static job *jobs = NULL;	// table of the jobs, ordered by id
+static int nJobs = 0, dimJobs = 0;
+static volatile sig_atomic_t childEvent = 0;	// set by SIGCHLD
+
+
+/**************************************************************************************************************************
+SIGCHLD handler: only async-signal-safe work, the children are reaped by reapJobs
+**************************************************************************************************************************/
+static void sigchldHandler(int sig)
+{
+	(void)sig;
+	childEvent = 1;
+}
+
+
+/**************************************************************************************************************************
+Install the SIGCHLD handler: the handler only takes note of the event, the children of the jobs are reaped by reapJobs
+without blocking the shell
+**************************************************************************************************************************/
+void initJobs()
+{
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = sigchldHandler;
+	sa.sa_flags = SA_RESTART | SA_NOCLDSTOP;	// fgets and waitpid are not interrupted
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGCHLD, &sa, NULL);
+}
+
+
+/**************************************************************************************************************************
+Add a job with the n pids of its commands and print its number.
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+unsigned int addJob(const pid_t *pids, int n, const char *line)
+{
+	job *j;
+	if (nJobs == dimJobs) {
+		int newDim = dimJobs == 0 ? 8 : 2 * dimJobs;
+		job *newJobs = realloc(jobs, sizeof(job) * newDim);
+		if (newJobs == NULL)
+			return 0;
+		jobs = newJobs;
+		dimJobs = newDim;
+	}
+	j = &jobs[nJobs];
+	if ((j->pids = malloc(sizeof(pid_t) * n)) == NULL || (j->line = strdup(line)) == NULL) {
+		free(j->pids);
+		return 0;
+	}
+	memcpy(j->pids, pids, sizeof(pid_t) * n);
+	j->id = nJobs == 0 ? 1 : jobs[nJobs - 1].id + 1;
+	j->n_pids = n;
+	j->running = n;
+	j->status = 0;
+	nJobs++;
+	fprintf(stdout, "[%u] %d\n", j->id, pids[n - 1]);
+	return 1;
+}
+
+
+/**************************************************************************************************************************
+Save the status of the child of the job
+**************************************************************************************************************************/
+static void childEnded(job * j, int i, int status)
+{
+	j->pids[i] = 0;
+	j->running--;
+	if (i == j->n_pids - 1)
+		j->status = status;
+}
+
+
+/**************************************************************************************************************************
+Take note of a child of a job reaped by someone else.
+Return 1 if the pid is of a job, else 0
+**************************************************************************************************************************/
+unsigned int jobsNotify(pid_t pid, int status)
+{
+	for (int k = 0; k < nJobs; k++)
+		for (int i = 0; i < jobs[k].n_pids; i++)
+			if (jobs[k].pids[i] == pid) {
+				childEnded(&jobs[k], i, status);
+				return 1;
+			}
+	return 0;
+}
+
+
+/**************************************************************************************************************************
+Wait the children of the job, block = 0 to only reap the ended ones
+**************************************************************************************************************************/
+static void waitJob(job * j, unsigned int block)
+{
+	int status;
+	pid_t ret;
+	for (int i = 0; i < j->n_pids; i++) {
+		if (j->pids[i] == 0)
+			continue;
+		ret = waitpid(j->pids[i], &status, block ? 0 : WNOHANG);
+		if (ret == j->pids[i])
+			childEnded(j, i, status);
+		else if (ret == -1)	// already reaped
+			childEnded(j, i, 0);
+	}
+}
+
+
+/**************************************************************************************************************************
+Print the job: "[n]  Running/Done/Exit s    command line"
+**************************************************************************************************************************/
+static void printJob(const job * j)
+{
+	char state[32];
+	if (j->running > 0)
+		strcpy(state, "Running");
+	else if (WIFEXITED(j->status) && WEXITSTATUS(j->status) != 0)
+		sprintf(state, "Exit %d", WEXITSTATUS(j->status));
+	else if (WIFSIGNALED(j->status))
+		sprintf(state, "Killed by signal %d", WTERMSIG(j->status));
+	else
+		strcpy(state, "Done");
+	fprintf(stdout, "[%u]  %-24s%s\n", j->id, state, j->line);
+}
+
+
+/**************************************************************************************************************************
+Remove the job k from the table
+**************************************************************************************************************************/
+static void removeJob(int k)
+{
+	free(jobs[k].pids);
+	free(jobs[k].line);
+	memmove(&jobs[k], &jobs[k + 1], sizeof(job) * (nJobs - k - 1));
+	nJobs--;
+}
+
+
+/**************************************************************************************************************************
+Reap the children of the jobs ended after the last call (no wait). With report = 1 the ended jobs are printed.
+The ended jobs are removed from the table
+**************************************************************************************************************************/
+void reapJobs(unsigned int report)
+{
+	if (!childEvent)
+		return;
+	childEvent = 0;
+	for (int k = 0; k < nJobs; k++) {
+		waitJob(&jobs[k], 0);
+		if (jobs[k].running == 0) {
+			if (report)
+				printJob(&jobs[k]);
+			removeJob(k--);
+		}
+	}
+}
+
+
+/**************************************************************************************************************************
+Find the job of "%n" or of a pid (a number above 0).
+Return -1 if it doesn't exist or the argument isn't a number (with error), else the index in the table
+**************************************************************************************************************************/
+static int findJob(const char *arg, const char *builtin)
+{
+	const char *num = arg + (arg[0] == '%');
+	char *end;
+	long n = strtol(num, &end, 10);
+	for (int k = 0; end != num && *end == '\0' && n > 0 && k < nJobs; k++) {	// only a number above 0
+		if (arg[0] == '%' && jobs[k].id == n)
+			return k;
+		for (int i = 0; arg[0] != '%' && i < jobs[k].n_pids; i++)
+			if (jobs[k].pids[i] == n)
+				return k;
+	}
+	fprintf(stdout, RED "micro-bash: %s: %s: no such job" RESET_COLOR "\n", builtin, arg);
+	return -1;
+}
+
+
+/**************************************************************************************************************************
+Build in jobs command: print the jobs (running or ended and not yet reported)
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+unsigned int jobsBuiltin(char **args, int num_arg, int fd_in, int fd_out)
+{
+	(void)fd_in;
+	(void)fd_out;
+	(void)args;
+	(void)num_arg;
+	for (int k = 0; k < nJobs; k++) {
+		waitJob(&jobs[k], 0);
+		printJob(&jobs[k]);
+		if (jobs[k].running == 0)
+			removeJob(k--);
+	}
+	return 1;
+}
+
+
+/**************************************************************************************************************************
+Build in wait command:
+ - wait			wait all the jobs;
+ - wait %n|pid...	wait the jobs, lastStatus is the status of the last one.
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+unsigned int waitBuiltin(char **args, int num_arg, int fd_in, int fd_out)
+{
+	(void)fd_in;
+	(void)fd_out;
+	int k;
+	if (num_arg == 1) {
+		while (nJobs > 0) {
+			waitJob(&jobs[0], 1);
+			removeJob(0);
+		}
+		lastStatus = 0;
+		return 1;
+	}
+	for (int i = 1; i < num_arg; i++) {
+		if ((k = findJob(args[i], "wait")) == -1) {
+			lastStatus = 127;
+			return 0;
+		}
+		waitJob(&jobs[k], 1);
+		saveStatus(jobs[k].status);
+		removeJob(k);
+	}
+	return 1;
+}
+
+
+/**************************************************************************************************************************
+Build in fg command: print the command line of the job (last one if there is no %n) and wait for it.
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+unsigned int fgBuiltin(char **args, int num_arg, int fd_in, int fd_out)
+{
+	(void)fd_in;
+	(void)fd_out;
+	int k = nJobs - 1;
+	if (num_arg > 2) {
+		fprintf(stdout, RED "micro-bash: fg: too much arguments" RESET_COLOR "\n");
+		return 0;
+	}
+	if (nJobs == 0) {
+		fprintf(stdout, RED "micro-bash: fg: no current job" RESET_COLOR "\n");
+		return 0;
+	}
+	if (num_arg == 2 && (k = findJob(args[1], "fg")) == -1)
+		return 0;
+	fprintf(stdout, "%s\n", jobs[k].line);
+	waitJob(&jobs[k], 1);
+	saveStatus(jobs[k].status);
+	removeJob(k);
+	return 1;
+}
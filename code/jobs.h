@@ -0,0 +1,69 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <sys/types.h>
+
+
+/**************************************************************************************************************************
+Job Struct: command line executed in background with "&" and the pids of its commands.
+**************************************************************************************************************************/
+typedef struct {
+	unsigned int id;	// number of the job ([1], [2], ...)
+	pid_t *pids;		// pids of the commands of the pipe, 0 when the child is reaped
+	int n_pids, running;
+	int status;		// status of the last command of the pipe
+	char *line;		// command line of the job
+} job;
+
+
+/**************************************************************************************************************************
+Install the SIGCHLD handler: the handler only takes note of the event, the children of the jobs are reaped by reapJobs
+without blocking the shell
+**************************************************************************************************************************/
+void initJobs();
+
+
+/**************************************************************************************************************************
+Add a job with the n pids of its commands and print its number.
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+unsigned int addJob(const pid_t *, int, const char *);
+
+
+/**************************************************************************************************************************
+Reap the children of the jobs ended after the last call (no wait). With report = 1 the ended jobs are printed.
+The ended jobs are removed from the table
+**************************************************************************************************************************/
+void reapJobs(unsigned int);
+
+
+/**************************************************************************************************************************
+Take note of a child of a job reaped by someone else.
+Return 1 if the pid is of a job, else 0
+**************************************************************************************************************************/
+unsigned int jobsNotify(pid_t, int);
+
+
+/**************************************************************************************************************************
+Build in jobs command: print the jobs (running or ended and not yet reported)
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+unsigned int jobsBuiltin(char **, int, int, int);
+
+
+/**************************************************************************************************************************
+Build in wait command:
+ - wait			wait all the jobs;
+ - wait %n|pid...	wait the jobs, lastStatus is the status of the last one.
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+unsigned int waitBuiltin(char **, int, int, int);
+
+
+/**************************************************************************************************************************
+Build in fg command: print the command line of the job (last one if there is no %n) and wait for it.
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+unsigned int fgBuiltin(char **, int, int, int);
+
+#endif
@@ -0,0 +1,61 @@
+#include <string.h>
+#include "lexer.h"
+
+#define BLANKS " \t\n"	// separators of the words
+#define OPERATORS "|<>&;"	// operators, they end the words too
+
+
+/**************************************************************************************************************************
+Split the command line in tokens with one pass: words are terminated with '\0' inside the line, operators are "|", "<",
+"<<", "<<<", ">", "&" and ";" (they don't need spaces around). The tokens are added to the queue and num_pipe is the
+number of "|".
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+unsigned int lexer(char *line, queue * q, unsigned int *num_pipe)
+{
+	char c;
+	unsigned int ok;
+	*num_pipe = 0;
+	while ((c = *line) != '\0') {
+		if (strchr(BLANKS, c) != NULL) {	// skip spaces, tabs and '\n'
+			line++;
+			continue;
+		}
+		if (strchr(OPERATORS, c) == NULL) {	// word until a space or an operator
+			char *start = line;
+			line += strcspn(line, BLANKS OPERATORS);
+			c = *line;
+			*line = '\0';
+			if (!enqueue(q, (token) { WORD, start }))
+				return 0;
+			if (c == '\0')
+				break;
+			if (strchr(OPERATORS, c) == NULL) {
+				line++;
+				continue;
+			}
+		}
+		// c is an operator, its char can be overwritten by the end of the previous word
+		if (c == '|') {
+			ok = enqueue(q, (token) { PIPE, "|" });
+			(*num_pipe)++;
+		} else if (c == '<' && line[1] == '<' && line[2] == '<') {
+			ok = enqueue(q, (token) { HERESTRING, "<<<" });
+			line += 2;
+		} else if (c == '<' && line[1] == '<') {
+			ok = enqueue(q, (token) { HEREDOC, "<<" });
+			line++;
+		} else if (c == '<')
+			ok = enqueue(q, (token) { REDIR_IN, "<" });
+		else if (c == '>')
+			ok = enqueue(q, (token) { REDIR_OUT, ">" });
+		else if (c == ';')
+			ok = enqueue(q, (token) { SEMICOLON, ";" });
+		else
+			ok = enqueue(q, (token) { BACKGROUND, "&" });
+		if (!ok)
+			return 0;
+		line++;
+	}
+	return 1;
+}
@@ -0,0 +1,15 @@
+#ifndef LEXER_H
+#define LEXER_H
+
+#include "queue.h"
+
+
+/**************************************************************************************************************************
+Split the command line in tokens with one pass: words are terminated with '\0' inside the line, operators are "|", "<",
+"<<", "<<<", ">", "&" and ";" (they don't need spaces around). The tokens are added to the queue and num_pipe is the
+number of "|".
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+unsigned int lexer(char *, queue *, unsigned int *);
+
+#endif
@@ -0,0 +1,321 @@
+#define _GNU_SOURCE
+
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <termios.h>
+#include "lineedit.h"
+#include "history.h"
+
+#define CTRLKEY(c) ((c) & 0x1f)
+
+
+/**************************************************************************************************************************
+Line being edited: text, length, cursor and the entry of the history shown (-1 for a new line, so the history is read
+only when it's used)
+**************************************************************************************************************************/
+typedef struct {
+	char *buf;
+	int dim, len, pos;
+	int hist;
+	const char *prompt;
+} editLine;
+
+static char *lineBuf = NULL;	// buffer of the lines, it grows for long lines
+static size_t lineDim = 0;
+
+
+/**************************************************************************************************************************
+Write the string on the terminal
+**************************************************************************************************************************/
+static void writeStr(const char *s, size_t len)
+{
+	ssize_t n;
+	while (len > 0 && (n = write(STDOUT_FILENO, s, len)) > 0) {
+		s += n;
+		len -= n;
+	}
+}
+
+
+/**************************************************************************************************************************
+Redraw the line with one write: prompt, text, clear to the end of the row and cursor back to its position
+**************************************************************************************************************************/
+static void refreshLine(const editLine * l)
+{
+	size_t promptLen = strlen(l->prompt);
+	char *out = malloc(promptLen + l->len + 32);
+	int n;
+	if (out == NULL)
+		return;
+	out[0] = '\r';
+	memcpy(out + 1, l->prompt, promptLen);
+	memcpy(out + 1 + promptLen, l->buf, l->len);
+	n = 1 + promptLen + l->len;
+	n += sprintf(out + n, "\x1b[K");
+	if (l->pos < l->len)
+		n += sprintf(out + n, "\x1b[%dD", l->len - l->pos);
+	writeStr(out, n);
+	free(out);
+}
+
+
+/**************************************************************************************************************************
+Make room for len chars, '\n' and '\0' in the buffer of the line.
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+static unsigned int reserve(editLine * l, size_t len)
+{
+	char *newBuf;
+	size_t newDim = l->dim;
+	if (len + 2 <= (size_t)l->dim)
+		return 1;
+	while (newDim < len + 2)
+		newDim = newDim == 0 ? 256 : 2 * newDim;
+	if ((newBuf = realloc(l->buf, newDim)) == NULL)
+		return 0;
+	lineBuf = l->buf = newBuf;
+	lineDim = l->dim = newDim;
+	return 1;
+}
+
+
+/**************************************************************************************************************************
+Replace the text of the line, the cursor goes to the end
+**************************************************************************************************************************/
+static void setLine(editLine * l, const char *s, size_t len)
+{
+	if (!reserve(l, len))
+		return;
+	memcpy(l->buf, s, len);
+	l->len = l->pos = len;
+}
+
+
+/**************************************************************************************************************************
+Show the entry of the history (the empty line after the last one)
+**************************************************************************************************************************/
+static void showHistory(editLine * l, int i)
+{
+	size_t len;
+	const char *s;
+	if (i < 0 || i > historyCount())
+		return;
+	l->hist = i;
+	if (i == historyCount()) {
+		l->hist = -1;
+		setLine(l, "", 0);
+	}
+	else {
+		s = historyEntry(i, &len);
+		setLine(l, s, len);
+	}
+	refreshLine(l);
+}
+
+
+/**************************************************************************************************************************
+Reverse search with ctrl+R: every char refines the string, ctrl+R goes to an older entry.
+Return 1 if the line has to be executed (enter), else 0 (the found entry is in the line, to edit)
+**************************************************************************************************************************/
+static unsigned int reverseSearch(editLine * l)
+{
+	char query[256], out[512], c;
+	int qlen = 0, found = -1, n;
+	size_t len = 0;
+	const char *s = "";
+	query[0] = '\0';
+	while (1) {
+		if (found >= 0)
+			s = historyEntry(found, &len);
+		n = snprintf(out, sizeof(out), "\r(reverse-i-search)`%s': ", query);
+		writeStr(out, n < (int)sizeof(out) ? n : (int)sizeof(out) - 1);
+		writeStr(s, found >= 0 ? len : 0);
+		writeStr("\x1b[K", 3);
+		if (read(STDIN_FILENO, &c, 1) != 1)
+			return 0;
+		if (c == CTRLKEY('R')) {
+			int older = searchHistory(query, found >= 0 ? found : historyCount());
+			found = older >= 0 ? older : found;
+		} else if (c == 127 || c == CTRLKEY('H')) {
+			if (qlen > 0)
+				query[--qlen] = '\0';
+			found = qlen > 0 ? searchHistory(query, historyCount()) : -1;
+		} else if (c == CTRLKEY('G') || c == CTRLKEY('C')) {	// cancel: the line as it was
+			refreshLine(l);
+			return 0;
+		} else if ((unsigned char)c >= ' ' && c != 127 && qlen < (int)sizeof(query) - 1) {
+			query[qlen++] = c;
+			query[qlen] = '\0';
+			found = searchHistory(query, found >= 0 ? found + 1 : historyCount());
+		} else {	// enter or other keys: the entry found is the line
+			if (found >= 0) {
+				setLine(l, s, len);
+				l->hist = found;
+			}
+			refreshLine(l);
+			return c == '\n' || c == '\r';
+		}
+	}
+}
+
+
+/**************************************************************************************************************************
+Escape sequence of the arrows and of the keys home, end and delete after ESC
+**************************************************************************************************************************/
+static void escapeKey(editLine * l)
+{
+	char seq[3];
+	if (read(STDIN_FILENO, seq, 1) != 1 || read(STDIN_FILENO, seq + 1, 1) != 1)
+		return;
+	if (seq[0] != '[' && seq[0] != 'O')
+		return;
+	if (seq[1] >= '0' && seq[1] <= '9') {	// ESC [ n ~
+		if (read(STDIN_FILENO, seq + 2, 1) != 1 || seq[2] != '~')
+			return;
+		if (seq[1] == '3' && l->pos < l->len) {	// delete
+			memmove(l->buf + l->pos, l->buf + l->pos + 1, l->len - l->pos - 1);
+			l->len--;
+		} else if (seq[1] == '1' || seq[1] == '7')
+			l->pos = 0;
+		else if (seq[1] == '4' || seq[1] == '8')
+			l->pos = l->len;
+		refreshLine(l);
+		return;
+	}
+	switch (seq[1]) {
+	case 'A':	// up
+		showHistory(l, (l->hist < 0 ? historyCount() : l->hist) - 1);
+		return;
+	case 'B':	// down
+		if (l->hist >= 0)
+			showHistory(l, l->hist + 1);
+		return;
+	case 'C':	// right
+		if (l->pos < l->len)
+			l->pos++;
+		break;
+	case 'D':	// left
+		if (l->pos > 0)
+			l->pos--;
+		break;
+	case 'H':
+		l->pos = 0;
+		break;
+	case 'F':
+		l->pos = l->len;
+		break;
+	}
+	refreshLine(l);
+}
+
+
+/**************************************************************************************************************************
+Edit the line in raw mode until enter or ctrl+D on an empty line.
+Return 0 if there is a ctrl+D on an empty line or errors, else 1
+**************************************************************************************************************************/
+static unsigned int editLoop(editLine * l)
+{
+	char c;
+	while (read(STDIN_FILENO, &c, 1) == 1) {
+		switch (c) {
+		case '\r':
+		case '\n':
+			return 1;
+		case CTRLKEY('D'):
+			if (l->len == 0)
+				return 0;
+			if (l->pos < l->len) {
+				memmove(l->buf + l->pos, l->buf + l->pos + 1, l->len - l->pos - 1);
+				l->len--;
+			}
+			break;
+		case CTRLKEY('C'):	// new empty line
+			writeStr("^C\n", 3);
+			l->len = l->pos = 0;
+			l->hist = -1;
+			break;
+		case 127:
+		case CTRLKEY('H'):
+			if (l->pos > 0) {
+				memmove(l->buf + l->pos - 1, l->buf + l->pos, l->len - l->pos);
+				l->pos--;
+				l->len--;
+			}
+			break;
+		case CTRLKEY('A'):
+			l->pos = 0;
+			break;
+		case CTRLKEY('E'):
+			l->pos = l->len;
+			break;
+		case CTRLKEY('U'):
+			memmove(l->buf, l->buf + l->pos, l->len - l->pos);
+			l->len -= l->pos;
+			l->pos = 0;
+			break;
+		case CTRLKEY('K'):
+			l->len = l->pos;
+			break;
+		case CTRLKEY('P'):
+			showHistory(l, (l->hist < 0 ? historyCount() : l->hist) - 1);
+			continue;
+		case CTRLKEY('N'):
+			if (l->hist >= 0)
+				showHistory(l, l->hist + 1);
+			continue;
+		case CTRLKEY('R'):
+			if (reverseSearch(l))
+				return 1;
+			continue;
+		case '\x1b':
+			escapeKey(l);
+			continue;
+		default:
+			if ((unsigned char)c < ' ' || !reserve(l, l->len + 1))
+				continue;
+			memmove(l->buf + l->pos + 1, l->buf + l->pos, l->len - l->pos);
+			l->buf[l->pos++] = c;
+			l->len++;
+			if (l->pos == l->len) {	// at the end: only the char is written
+				writeStr(&c, 1);
+				continue;
+			}
+		}
+		refreshLine(l);
+	}
+	return 0;
+}
+
+
+/**************************************************************************************************************************
+Read a command line from the terminal with editing (arrows, home/end, backspace/delete, ctrl+A/E/U/K), history (up and
+down arrows) and reverse search (ctrl+R, again for an older entry, enter to execute, ctrl+G to cancel).
+The prompt is already printed, it's printed again when the line is redrawn.
+If stdin isn't a terminal the line is read with getline.
+Return the line (ending with '\n', valid until the next call), NULL if there is a ctrl+D on an empty line or errors
+**************************************************************************************************************************/
+char *readLine(const char *prompt)
+{
+	struct termios saved, raw;
+	editLine l = { lineBuf, lineDim, 0, 0, -1, prompt };
+	unsigned int ok;
+	if (tcgetattr(STDIN_FILENO, &saved) == -1)	// not a terminal
+		return getline(&lineBuf, &lineDim, stdin) == -1 ? NULL : lineBuf;
+	fflush(stdout);
+	raw = saved;
+	raw.c_lflag &= ~(ICANON | ECHO | ISIG | IEXTEN);
+	raw.c_iflag &= ~(IXON);
+	raw.c_cc[VMIN] = 1;
+	raw.c_cc[VTIME] = 0;
+	if (tcsetattr(STDIN_FILENO, TCSADRAIN, &raw) == -1)
+		return getline(&lineBuf, &lineDim, stdin) == -1 ? NULL : lineBuf;
+	ok = editLoop(&l) && reserve(&l, l.len);
+	tcsetattr(STDIN_FILENO, TCSADRAIN, &saved);
+	if (!ok)
+		return NULL;
+	writeStr("\n", 1);
+	l.buf[l.len] = '\n';
+	l.buf[l.len + 1] = '\0';
+	return l.buf;
+}
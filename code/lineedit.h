@@ -0,0 +1,16 @@
+#ifndef LINEEDIT_H
+#define LINEEDIT_H
+
+#include <stdio.h>
+
+
+/**************************************************************************************************************************
+Read a command line from the terminal with editing (arrows, home/end, backspace/delete, ctrl+A/E/U/K), history (up and
+down arrows) and reverse search (ctrl+R, again for an older entry, enter to execute, ctrl+G to cancel).
+The prompt is already printed, it's printed again when the line is redrawn.
+If stdin isn't a terminal the line is read with getline.
+Return the line (ending with '\n', valid until the next call), NULL if there is a ctrl+D on an empty line or errors
+**************************************************************************************************************************/
+char *readLine(const char *);
+
+#endif
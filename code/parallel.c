@@ -0,0 +1,288 @@
+#define _GNU_SOURCE
+
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#include "parallel.h"
+#include "parsing.h"
+#include "spawn.h"
+#include "variables.h"
+
+
+/**************************************************************************************************************************
+Command of the parallel: template and inputs
+**************************************************************************************************************************/
+typedef struct {
+	char **templ;		// command and arguments, with "{}"
+	int n_templ;
+	char **inputs;		// inputs after ":::", NULL to read them from in
+	int n_inputs;
+	FILE *in;		// lines of input
+	int next;		// index of the next input
+} parallelInput;
+
+
+/**************************************************************************************************************************
+Output of a command with -k: memfd with the output, written when all the previous ones are written
+**************************************************************************************************************************/
+typedef struct {
+	int fd;
+	unsigned int done;
+} parallelOutput;
+
+
+/**************************************************************************************************************************
+Number of CPUs usable by the shell
+**************************************************************************************************************************/
+static int numCpus()
+{
+	cpu_set_t set;
+	if (sched_getaffinity(0, sizeof(set), &set) == 0)
+		return CPU_COUNT(&set);
+	return sysconf(_SC_NPROCESSORS_ONLN) > 0 ? sysconf(_SC_NPROCESSORS_ONLN) : 1;
+}
+
+
+/**************************************************************************************************************************
+Take the next input.
+Return NULL if there aren't more inputs, else the input
+**************************************************************************************************************************/
+static char *nextInput(parallelInput * pin)
+{
+	char *line = NULL;
+	size_t dim = 0;
+	ssize_t len;
+	if (pin->inputs != NULL)
+		return pin->next < pin->n_inputs ? pin->inputs[pin->next++] : NULL;
+	while ((len = getline(&line, &dim, pin->in)) != -1) {
+		if (len > 0 && line[len - 1] == '\n')
+			line[--len] = '\0';
+		if (len == 0)	// empty lines are not inputs
+			continue;
+		char *input = (char *)arenaAlloc(&lineArena, len + 1);
+		memcpy(input, line, len + 1);
+		free(line);
+		pin->next++;
+		return input;
+	}
+	free(line);
+	return NULL;
+}
+
+
+/**************************************************************************************************************************
+Build the arguments of the command for the input: "{}" replaced, or the input as last argument
+**************************************************************************************************************************/
+static char **buildArgs(const parallelInput * pin, const char *input)
+{
+	char **args = (char **)arenaAlloc(&lineArena, sizeof(char *) * (pin->n_templ + 2));
+	unsigned int replaced = 0;
+	size_t inLen = strlen(input);
+	int i;
+	for (i = 0; i < pin->n_templ; i++) {
+		const char *t = pin->templ[i], *p;
+		size_t n = 0, len;
+		if (strstr(t, "{}") == NULL) {
+			args[i] = pin->templ[i];
+			continue;
+		}
+		for (p = t; (p = strstr(p, "{}")) != NULL; p += 2)	// number of "{}"
+			n++;
+		len = strlen(t) + n * inLen;
+		args[i] = (char *)arenaAlloc(&lineArena, len + 1);
+		args[i][0] = '\0';
+		for (p = t; *p; ) {
+			const char *q = strstr(p, "{}");
+			if (q == NULL) {
+				strcat(args[i], p);
+				break;
+			}
+			strncat(args[i], p, q - p);
+			strcat(args[i], input);
+			p = q + 2;
+		}
+		replaced = 1;
+	}
+	if (!replaced)
+		args[i++] = (char *)input;
+	args[i] = NULL;
+	return args;
+}
+
+
+/**************************************************************************************************************************
+Write the outputs of the ended commands that follow the ones already written (-k).
+**************************************************************************************************************************/
+static void flushOutputs(parallelOutput * outs, int n_outs, int *written, int fd_out)
+{
+	struct stat st;
+	off_t off;
+	ssize_t n;
+	char buf[8192];
+	int out = fd_out >= 0 ? fd_out : STDOUT_FILENO;
+	for (; *written < n_outs && outs[*written].done; (*written)++) {
+		int fd = outs[*written].fd;
+		if (fstat(fd, &st) == 0) {
+			off = 0;
+			while (off < st.st_size && sendfile(out, fd, &off, st.st_size - off) > 0)
+				;
+			// sendfile can't write on some files (O_APPEND)
+			while (off < st.st_size && (n = pread(fd, buf, sizeof(buf), off)) > 0 && write(out, buf, n) == n)
+				off += n;
+		}
+		close(fd);
+	}
+}
+
+
+/**************************************************************************************************************************
+Wait the first of the running commands that ends, polling their pidfds: the other children of the shell (the stages of
+the same pipe, the jobs in background) are left to their own waits. A command without pidfd (old kernel) is waited
+alone.
+Return its index, -1 if there is an error
+**************************************************************************************************************************/
+static int waitFirst(const pid_t * pids, const int *pidfds, struct pollfd *pfds, int running, int *status)
+{
+	int k;
+	for (k = 0; k < running; k++) {
+		if (pidfds[k] < 0)
+			return waitpid(pids[k], status, 0) == -1 ? -1 : k;
+		pfds[k].fd = pidfds[k];
+		pfds[k].events = POLLIN;
+	}
+	while (poll(pfds, running, -1) == -1)
+		if (errno != EINTR)	// SIGCHLD of the other children
+			return -1;
+	for (k = 0; k < running && !(pfds[k].revents & (POLLIN | POLLHUP)); k++)
+		;
+	if (k == running || waitpid(pids[k], status, 0) == -1)
+		return -1;
+	return k;
+}
+
+
+/**************************************************************************************************************************
+Build in parallel command: parallel [-j n | -jn] [-k] command args... [::: inputs...]
+Run the command once for each input (the words after ":::" or the lines read from fd_in), "{}" in the arguments is
+replaced by the input, without "{}" the input is the last argument. At most n commands (default: number of CPUs)
+run together, with -k the outputs are written in the order of the inputs.
+fd_in and fd_out are the redirections of the command or the pipe before it (-2 if there aren't).
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+unsigned int parallelBuiltin(char **args, int num_arg, int fd_in, int fd_out)
+{
+	int maxJobs = numCpus(), keep = 0, i = 1, running = 0, failed = 0, stop = 0;
+	int n_outs = 0, dimOuts = 0, written = 0, nullFd = -2;
+	parallelInput pin = { NULL, 0, NULL, 0, NULL, 0 };
+	parallelOutput *outs = NULL, *grown;
+	pid_t *pids;		// running commands, with their pidfd and the index of their input in index
+	int *pidfds, *index;
+	struct pollfd *pfds;
+	const char *path;
+	char *input;
+	for (; i < num_arg && args[i][0] == '-'; i++) {	// options
+		if (strcmp(args[i], "-k") == 0)
+			keep = 1;
+		else if (strcmp(args[i], "-j") == 0 && i + 1 < num_arg && atoi(args[i + 1]) > 0)
+			maxJobs = atoi(args[++i]);
+		else if (strncmp(args[i], "-j", 2) == 0 && atoi(args[i] + 2) > 0)	// attached, -j4
+			maxJobs = atoi(args[i] + 2);
+		else
+			break;
+	}
+	pin.templ = args + i;
+	for (pin.n_templ = 0; i < num_arg && strcmp(args[i], ":::") != 0; i++)
+		pin.n_templ++;
+	if (pin.n_templ == 0) {
+		fprintf(stdout, RED "micro-bash: parallel: usage: parallel [-j n] [-k] command args... [::: inputs...]" RESET_COLOR "\n");
+		return 0;
+	}
+	if (i < num_arg) {	// inputs after ":::"
+		pin.inputs = args + i + 1;
+		pin.n_inputs = num_arg - i - 1;
+	} else {	// a line of input for each command, the commands read /dev/null
+		if ((pin.in = fdopen(dup(fd_in >= 0 ? fd_in : STDIN_FILENO), "r")) == NULL)
+			return 0;
+		nullFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+	}
+	if ((path = resolveCommand(pin.templ[0])) == NULL) {	// search the command only once
+		if (pin.in != NULL)
+			fclose(pin.in);
+		closeRedirections(nullFd, -2);
+		return 0;
+	}
+	pids = (pid_t *)arenaAlloc(&lineArena, sizeof(pid_t) * maxJobs);
+	pidfds = (int *)arenaAlloc(&lineArena, sizeof(int) * maxJobs);
+	index = (int *)arenaAlloc(&lineArena, sizeof(int) * maxJobs);
+	pfds = (struct pollfd *)arenaAlloc(&lineArena, sizeof(struct pollfd) * maxJobs);
+
+	while (1) {
+		while (!stop && running < maxJobs && (input = nextInput(&pin)) != NULL) {	// start the commands
+			int out = fd_out;
+			if (keep) {
+				if (n_outs == dimOuts) {
+					if ((grown = realloc(outs, sizeof(parallelOutput) * (dimOuts == 0 ? 64 : 2 * dimOuts))) == NULL) {
+						fprintf(stdout, RED "micro-bash: parallel: %s" RESET_COLOR "\n", strerror(errno));
+						stop = 1;	// the running commands end, no new ones
+						failed++;
+						break;
+					}
+					outs = grown;
+					dimOuts = dimOuts == 0 ? 64 : 2 * dimOuts;
+				}
+				if ((out = memfd_create("parallel", MFD_CLOEXEC)) == -1) {
+					fprintf(stdout, RED "micro-bash: parallel: memfd_create: %s" RESET_COLOR "\n", strerror(errno));
+					stop = 1;
+					failed++;
+					break;
+				}
+				outs[n_outs].fd = out;
+				outs[n_outs].done = 0;
+			}
+			pids[running] = spawnCommand(path, buildArgs(&pin, input), exportedEnv(), nullFd, out, NULL, 0, NULL);
+			if (pids[running] == -1) {
+				failed++;
+				if (keep)
+					outs[n_outs++].done = 1;
+				continue;
+			}
+			pidfds[running] = syscall(SYS_pidfd_open, pids[running], 0);
+			index[running++] = keep ? n_outs++ : 0;
+		}
+		if (running == 0)
+			break;
+		int status, k;
+		if ((k = waitFirst(pids, pidfds, pfds, running, &status)) == -1)
+			break;
+		if (pidfds[k] >= 0)
+			close(pidfds[k]);
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+			failed++;
+		if (keep) {
+			outs[index[k]].done = 1;
+			flushOutputs(outs, n_outs, &written, fd_out);
+		}
+		pids[k] = pids[--running];
+		pidfds[k] = pidfds[running];
+		index[k] = index[running];
+	}
+	for (int k = 0; k < running; k++)	// left by an error of wait
+		if (pidfds[k] >= 0)
+			close(pidfds[k]);
+	if (keep)
+		flushOutputs(outs, n_outs, &written, fd_out);
+	free(outs);
+	if (pin.in != NULL)
+		fclose(pin.in);
+	closeRedirections(nullFd, -2);
+	lastStatus = failed > 0 ? 1 : 0;
+	return 1;
+}
@@ -0,0 +1,15 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+
+/**************************************************************************************************************************
+Build in parallel command: parallel [-j n | -jn] [-k] command args... [::: inputs...]
+Run the command once for each input (the words after ":::" or the lines read from fd_in), "{}" in the arguments is
+replaced by the input, without "{}" the input is the last argument. At most n commands (default: number of CPUs)
+run together, with -k the outputs are written in the order of the inputs.
+fd_in and fd_out are the redirections of the command or the pipe before it (-2 if there aren't).
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+unsigned int parallelBuiltin(char **, int, int, int);
+
+#endif
@@ -1,118 +1,202 @@
-#define _DEFAULT_SOURCE
 #define _GNU_SOURCE
 
 #include <unistd.h>
 #include <string.h>
-#include <ctype.h>
 #include <fcntl.h>
 #include <sys/wait.h>
+#include <sys/mman.h>
+#include <signal.h>
+#include <time.h>
 #include "parsing.h"
+#include "spawn.h"
+#include "pathcache.h"
+#include "lexer.h"
+#include "jobs.h"
+#include "builtins.h"
+#include "session.h"
+#include "trace.h"
+#include "variables.h"
+#include "lineedit.h"
+#include "history.h"
+#include "pipesize.h"
+#include "cpusched.h"
+#include "plancache.h"
+#include "script.h"
+
+int lastStatus = 0;
+int prevStatus = 0;
+unsigned int noExec = 0;
+unsigned int interactive = 0;
+arena lineArena;
 
 
 /**************************************************************************************************************************
-Print current directory
+Print the prompt with the current directory (rendered by cd)
 **************************************************************************************************************************/
 void printCurDir()
 {
-	char *dir = NULL;
-	fprintf(stdout, GREEN "%s" RESET_COLOR "$ ", (dir = get_current_dir_name()));
-	free(dir);
+	fputs(shell.prompt, stdout);
 }
 
 
 /**************************************************************************************************************************
-Take the input and check if there is a ctrl+D in the first row.
-Return 0 if there is a ctrl+D or errors.
+Take the next line from the reader, in interactive mode from the terminal with the line editor ("^D" is printed at
+the end) and it's added to the history. The line has no length limit and it's valid until the next call.
+Return NULL if there is a ctrl+D or errors, else the line
 **************************************************************************************************************************/
-unsigned int inputCommand(char *s)
+char *inputCommand(reader * in)
 {
-	if (fgets(s, MAXCOMM, stdin) == NULL) {	// insert command
+	char *line;
+	size_t len;
+	if (!interactive)
+		return nextLine(in, NULL);
+	if ((line = readLine(shell.prompt)) == NULL) {	// insert command
 		fprintf(stdout, "^D\n");	// ctrl+D to exit
-		return 0;
+		return NULL;
 	}
-	return 1;
+	len = strcspn(line, "\n");
+	if (line[len] == '\n') {	// without '\n' in the history
+		line[len] = '\0';
+		addHistory(line);
+		line[len] = '\n';
+	} else
+		addHistory(line);
+	return line;
 }
 
 
 /**************************************************************************************************************************
-Function for environment variables.
-Return NULL if there is an error, else return the environment variable
+Write the data in a new memfd (here-documents and here-strings), the file system is never used.
+Return -1 if there is an error, else the memfd at the start of the data
 **************************************************************************************************************************/
-char *environmentVar(char *arg_token)
+int memoryFile(const char *data, size_t len)
 {
-	unsigned int i;
-	for (i = 0; i < strlen(arg_token); i++)
-		arg_token[i] = toupper(arg_token[i]);	// to upper case (example.: $home = $HOME)
-	if ((arg_token = getenv(arg_token + 1)) == NULL){	// insert arguments
-		fprintf(stdout, RED "*** Environment variable does not exist ***" RESET_COLOR "\n");
-		return NULL;
+	ssize_t n;
+	int fd;
+	if ((fd = memfd_create("ubash-heredoc", MFD_CLOEXEC)) == -1) {
+		perror("micro-bash: memfd_create");
+		return -1;
 	}
-	return arg_token;
+	while (len > 0 && (n = write(fd, data, len)) > 0) {
+		data += n;
+		len -= n;
+	}
+	if (len > 0 || lseek(fd, 0, SEEK_SET) == -1) {
+		close(fd);
+		return -1;
+	}
+	return fd;
 }
 
 
 /**************************************************************************************************************************
-Build in cd command.
-Return 0 if there is an error, else 1.
+Expand the variables of the text of a here-document and write it in a new memfd.
+Return -1 if there is an error, else the memfd at the start of the data
 **************************************************************************************************************************/
-unsigned int cd(char *dir, unsigned int num_arg)
+int hereDocument(char *text)
 {
-	if (num_arg > 2) {	// arguments error
-		fprintf(stdout, RED "micro-bash: cd: too much arguments" RESET_COLOR "\n");
-		return 0;
-	} else if (num_arg == 1) {	// no arguments
-		if (chdir(getenv("HOME")) == -1)
-			fprintf(stdout, RED "micro-bash: cd: %s: File or directory doesn't exist" RESET_COLOR "\n", dir);
-		return 1;
-	}
-	if (strcmp(dir, "-") == 0 || strcmp(dir, "~") == 0) {	// "cd -" or "cd ~"
-		if (chdir(getenv("HOME")) == -1)
-			fprintf(stdout, RED "micro-bash: cd: %s: File or directory doesn't exist" RESET_COLOR "\n", dir);
-		return 1;
+	text = expandWord(text);
+	return memoryFile(text, strlen(text));
+}
+
+
+/**************************************************************************************************************************
+Write the word and '\n' in a new memfd, the input of a here-string.
+Return -1 if there is an error, else the memfd at the start of the data
+**************************************************************************************************************************/
+int hereString(const char *word)
+{
+	size_t len = strlen(word);
+	char *data = (char *)arenaAlloc(&lineArena, len + 1);
+	memcpy(data, word, len);
+	data[len] = '\n';
+	return memoryFile(data, len + 1);
+}
+
+
+/**************************************************************************************************************************
+Read the lines of the here-document until the line equal to end, the variables are expanded later.
+Return NULL if there is an error, else the text of the document (in lineArena)
+**************************************************************************************************************************/
+char *readDocument(reader * in, const char *end)
+{
+	char *line, *data = NULL, *text;
+	size_t len, dataLen = 0, dataDim = 0;
+	while (1) {
+		if (interactive) {
+			fputs("> ", stdout);
+			if ((line = readLine("> ")) != NULL)
+				line[strcspn(line, "\n")] = '\0';
+		} else
+			line = nextLine(in, NULL);
+		if (line == NULL) {	// end of the input: the document ends here
+			fprintf(stdout, RED "micro-bash: here-document ended by end of file (wanted `%s')" RESET_COLOR "\n", end);
+			break;
+		}
+		if (strcmp(line, end) == 0)
+			break;
+		len = strlen(line);
+		if (dataLen + len + 1 > dataDim) {
+			char *newData;
+			while (dataLen + len + 1 > dataDim)
+				dataDim = dataDim == 0 ? 4096 : 2 * dataDim;
+			if ((newData = realloc(data, dataDim)) == NULL) {
+				free(data);
+				return NULL;
+			}
+			data = newData;
+		}
+		memcpy(data + dataLen, line, len);
+		data[dataLen + len] = '\n';
+		dataLen += len + 1;
 	}
-	if (chdir(dir) == -1) {
-		fprintf(stdout, RED "micro-bash: cd: %s: File or directory doesn't exist" RESET_COLOR "\n", dir);
-		return 0;
+	if ((text = (char *)arenaAlloc(&lineArena, dataLen + 1)) != NULL) {
+		if (dataLen > 0)
+			memcpy(text, data, dataLen);
+		text[dataLen] = '\0';
 	}
-	return 1;
+	free(data);
+	return text;
 }
 
 
 /**************************************************************************************************************************
-Single command, without pipes.
-Return 0 if there is an error, else 1
+Save the exit status of a child in lastStatus
 **************************************************************************************************************************/
-unsigned int execSingleCommand(char **arg_token, int num_arg, int fd_in, int fd_out)
+void saveStatus(int status)
 {
-	pid_t child_pid;
-	arg_token = (char **)realloc(arg_token, sizeof(char *) * (num_arg + 1));
-	arg_token[num_arg] = NULL;
-	if ((child_pid = fork()) == -1)
-		return 0;
-	if (child_pid == 0) {	// Child process
-		if (fd_in >= 0)
-			if (dup2(fd_in, STDIN_FILENO) == -1) {	// redirect input
-				perror("Error dup2 for input redirect\n");
-				return 0;
-			}
-		if (fd_out >= 0)
-			if (dup2(fd_out, STDOUT_FILENO) == -1) {	// redirect output
-				perror("Error dup2 for output redirect\n");
-				return 0;
-			}
-		execvp(arg_token[0], arg_token);	// execute command
-		// execvp failed
-		fprintf(stdout, RED "*** BAD COMMAND!!! ***" RESET_COLOR "\n");
-		exit(EXIT_FAILURE);
-	} else {
-		// father process
-		if (wait(NULL) == -1) {
-			free(arg_token);
-			return 0;
-		}
-		free(arg_token);
+	if (WIFEXITED(status))
+		lastStatus = WEXITSTATUS(status);
+	else if (WIFSIGNALED(status))
+		lastStatus = 128 + WTERMSIG(status);
+}
+
+
+/**************************************************************************************************************************
+Search the command in PATH before the fork.
+Return NULL if it doesn't exist (with error), else the absolute path
+**************************************************************************************************************************/
+const char *resolveCommand(const char *name)
+{
+	const char *path;
+	if ((path = lookupCommand(name)) == NULL) {
+		fprintf(stdout, RED "*** BAD COMMAND!!! *** - Error of: %s" RESET_COLOR "\n", name);
+		lastStatus = 127;
 	}
-	return 1;
+	return path;
+}
+
+
+/**************************************************************************************************************************
+Path of the command i of the pipeline, searched only the first time and remembered in the pipeline (and so in the
+plan cache).
+Return NULL if it doesn't exist (with error), else the absolute path
+**************************************************************************************************************************/
+const char *commandPath(const pipeline * pl, int i)
+{
+	if (pl->paths[i] == NULL)
+		pl->paths[i] = resolveCommand(pl->comm[i].argv[0]);
+	return pl->paths[i];
 }
 
 
@@ -120,11 +204,11 @@ unsigned int execSingleCommand(char **arg_token, int num_arg, int fd_in, int fd_
 Redirect input.
 Return -1 is there is an error, else return the file descriptor
 **************************************************************************************************************************/
-int openRedirInput(char *arg_token)
+int openRedirInput(char *file)
 {
 	int fd_in = -2;
-	if ((fd_in = open(arg_token + 1, O_RDONLY)) < 0) {
-		fprintf(stdout, RED "micro-bash: %s: File or directory doesn't exist" RESET_COLOR "\n", arg_token + 1);
+	if ((fd_in = open(file, O_RDONLY | O_CLOEXEC)) < 0) {
+		fprintf(stdout, RED "micro-bash: %s: File or directory doesn't exist" RESET_COLOR "\n", file);
 		return -1;
 	}
 	return fd_in;
@@ -135,10 +219,10 @@ int openRedirInput(char *arg_token)
 Redirect output.
 Return -1 is there is an error, else return the file descriptor
 **************************************************************************************************************************/
-int openRedirOutput(char *arg_token)
+int openRedirOutput(char *file)
 {
 	int fd_out = -2;
-	if ((fd_out = open(arg_token + 1, O_TRUNC | O_CREAT | O_RDWR, 0666)) < 0) {
+	if ((fd_out = open(file, O_TRUNC | O_CREAT | O_RDWR | O_CLOEXEC, 0666)) < 0) {
 		fprintf(stdout, RED "micro-bash: Error opening file to redirect output" RESET_COLOR "\n");
 		return -1;
 	}
@@ -147,578 +231,632 @@ int openRedirOutput(char *arg_token)
 
 
 /**************************************************************************************************************************
-Wait for each child of father process and check if a child is interrupted with status != 0
+Close the file descriptors opened by openRedirections.
 Return 0 if there is an error, else 1
 **************************************************************************************************************************/
-unsigned int wait_children_inPipe(int numPipes, int *status, int *pid)
+unsigned int closeRedirections(int fd_in, int fd_out)
 {
-	for (int i = 0; i < numPipes + 1; i++) {
-		if (wait(status) == -1) {
+	unsigned int ok = 1;
+	if (fd_in >= 0 && close(fd_in) == -1)
+		ok = 0;
+	if (fd_out >= 0 && close(fd_out) == -1)
+		ok = 0;
+	return ok;
+}
+
+
+/**************************************************************************************************************************
+Open again the memfd of a here-document or here-string: the new descriptor has its own offset at the start, so the
+same document can be read by every iteration of a loop.
+Return -1 is there is an error, else return the file descriptor
+**************************************************************************************************************************/
+int openDocument(int memfd)
+{
+	char path[32];
+	int fd;
+	snprintf(path, sizeof(path), "/proc/self/fd/%d", memfd);
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) == -1)
+		perror("micro-bash: here-document");
+	return fd;
+}
+
+
+/**************************************************************************************************************************
+Open the redirections of the command in order, fd_in and fd_out are -2 if there isn't the redirection.
+Return 0 if there is an error (nothing remains open), else 1
+**************************************************************************************************************************/
+unsigned int openRedirections(const command * cmd, int *fd_in, int *fd_out)
+{
+	*fd_in = -2;
+	*fd_out = -2;
+	for (int i = 0; i < cmd->n_redir; i++) {
+		if (cmd->redir[i].type == REDIR_IN)
+			*fd_in = openRedirInput(cmd->redir[i].file);
+		else if (cmd->redir[i].fd >= 0)	// here-document or here-string, the memfd is closed by the parser
+			*fd_in = openDocument(cmd->redir[i].fd);
+		else
+			*fd_out = openRedirOutput(cmd->redir[i].file);
+		if (*fd_in == -1 || *fd_out == -1) {
+			closeRedirections(*fd_in, *fd_out);
 			return 0;
 		}
-		if (WIFEXITED(*status) && WEXITSTATUS(*status) != 0)
-			fprintf(stdout, LIGHT_BLUE "Process with pid %d ends with status %d" RESET_COLOR "\n", *pid, WEXITSTATUS(*status));
 	}
 	return 1;
 }
 
 
 /**************************************************************************************************************************
-Close file descriptor and reset input/output
-Retrurn 0 if there is an error, else 1
+Choose the build in command of the pipe executed inside the shell: the last one if possible, else the first one.
+Return -1 if there isn't, else its index
 **************************************************************************************************************************/
-unsigned int close_pipe(unsigned int *stdin_safe, unsigned int *stdout_safe, int numPipes, int *pipefds)
+int chooseInProcess(const pipeline * pl)
 {
-	for (int i = 0; i < 2 * numPipes; i++)
-		if (close(pipefds[i]) == -1)
-			break;
-	free(pipefds);
-	if (dup2(*stdin_safe, 0) == -1) {	// reset input
-		perror("Error in dup2\n");
+	if (pl->background)	// the shell doesn't wait for the job
+		return -1;
+	if (findBuiltin(&pl->comm[pl->n_comm - 1]) != NULL)
+		return pl->n_comm - 1;
+	for (int i = 0; i < pl->n_comm - 1; i++)
+		if (findBuiltin(&pl->comm[i]) != NULL)
+			return i;
+	return -1;
+}
+
+
+/**************************************************************************************************************************
+Wait for each child of father process (numPipes + 1 pids, 0 for a command executed in the shell) and check if a child
+is interrupted with status != 0. With times the children are waited in the order they end, saving their resources.
+The status of the last command of the pipe is the status of the pipe.
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+unsigned int wait_children_inPipe(int numPipes, pid_t *pids, stageTime *times)
+{
+	int status;
+	TRACE_START(start);
+	if (times != NULL && !waitStages(numPipes + 1, pids, times))
 		return 0;
+	for (int i = 0; i < numPipes + 1; i++) {
+		if (pids[i] == 0)
+			continue;
+		if (times != NULL)
+			status = times[i].status;
+		else if (waitpid(pids[i], &status, 0) == -1) {
+			return 0;
+		}
+		TRACE_SPAN(start, "wait", NULL);	// from the end of the previous child
+		TRACE_RESTART(start);
+		if (i == numPipes)
+			saveStatus(status);
+		if (numPipes > 0 && WIFEXITED(status) && WEXITSTATUS(status) != 0)
+			fprintf(stdout, LIGHT_BLUE "Process with pid %d ends with status %d" RESET_COLOR "\n", pids[i], WEXITSTATUS(status));
 	}
-	if (dup2(*stdout_safe, 1) == -1) {	// reset output
-		perror("Error in dup2\n");
+	return 1;
+}
+
+
+/**************************************************************************************************************************
+Single command, without pipes, in background if the line ends with "&" (a build in command in a child).
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+unsigned int execSingleCommand(const pipeline * pl)
+{
+	const command *cmd = &pl->comm[0];
+	const builtin *b = findBuiltin(cmd);
+	pid_t child_pid;
+	int fd_in, fd_out;
+	const char *path = NULL;
+	lineSched sched;
+	stageSched st;
+	const stageSched *stage;
+	TRACE_START(start);
+	if (b == NULL && (path = commandPath(pl, 0)) == NULL)	// unknown command, no fork
 		return 0;
-	}
-	if (close(*stdout_safe) == -1)
+	TRACE_SPAN(start, "resolve", cmd->argv[0]);
+	TRACE_START(redir);
+	if (!openRedirections(cmd, &fd_in, &fd_out))
+		return 0;
+	TRACE_SPAN(redir, "redirect", NULL);
+	TRACE_START(spawn);
+	initLineSched(&sched);
+	stage = stageSchedule(&sched, 0, 1, cmd, &st);
+	if (b != NULL)
+		child_pid = forkBuiltin(b, cmd, fd_in, fd_out, NULL, 0, stage);
+	else
+		child_pid = spawnCommand(path, cmd->argv, commandEnv(cmd->assign, cmd->n_assign), fd_in, fd_out, NULL, 0, stage);
+	TRACE_SPAN(spawn, "spawn", cmd->argv[0]);
+	if (!closeRedirections(fd_in, fd_out) || child_pid == -1)
 		return 0;
-	if (close(*stdin_safe) == -1)
+	// father process
+	if (pl->background)
+		return addJob(&child_pid, 1, pl->line);
+	if (!wait_children_inPipe(0, &child_pid, pl->times))
 		return 0;
 	return 1;
 }
 
 
 /**************************************************************************************************************************
-Check if:
- - ">" and black space;
- - more commands after ">file.extension";
- - "<" in right place.
+Execute the command of the pipeline with index i inside the shell, saving its resources with "time".
 Return 0 if there is an error, else 1
 **************************************************************************************************************************/
-unsigned int checkErrorPipedCommand(queue * q)
+unsigned int execTimedBuiltin(const pipeline * pl, int i, const builtin * b, int fd_in, int fd_out)
 {
-	queue q2;
-	// Create and copy of aux queue
-	create(&q2, size(q));
-	copyQueue(q, &q2);
-	
-	char * s1 = NULL;
-	do{						// take first command (command to pipe or empty queue)
-		if (isEmpty(&q2))
-			break;
-		s1 = dequeue(&q2);	// take first element from queue
-	} while (strcmp(s1, "|") != 0); // untile i have a pipe
-	while (!isEmpty(&q2)){
-		s1 = dequeue(&q2);		// take the second command
-		if (s1[0] == '>'){	
-			if (strlen(s1) == 1) {	// ">" and a space is an error
-				fprintf(stdout, RED "*** BAD COMMAND!!! ***" RESET_COLOR "\n");
-				reset(&q2);
-				return 0;
-			}
-			if (!isEmpty(&q2)) {	// more commands after ">file.extension" is an error
-				fprintf(stdout, RED "*** BAD COMMAND!!! ***" RESET_COLOR "\n");
-				reset(&q2);
-				return 0;
-			}
-		}
-		if (s1[0] == '<') {	// error because '<' only on first command
-			fprintf(stdout, RED "*** BAD COMMAND!!! ***" RESET_COLOR "\n");
-			reset(&q2);
-			return 0;
-		}
-	}
-	reset(&q2);
-	return 1;
+	struct rusage before;
+	unsigned int ok;
+	TRACE_START(start);
+	if (pl->times != NULL)
+		getrusage(RUSAGE_SELF, &before);
+	ok = execBuiltin(b, &pl->comm[i], fd_in, fd_out);
+	if (pl->times != NULL)
+		timeInProcess(&pl->times[i], &before);
+	TRACE_SPAN(start, "builtin", b->name);
+	return ok;
 }
 
 
 /**************************************************************************************************************************
-Execute commands with pipe
+Execute commands with pipe: the commands are searched before creating the pipes, "<" is the input of the first
+command and ">" the output of the last one. With "&" the pipe is a job in background.
+Each pipe is created with O_CLOEXEC just before the start of its writer and the father closes the ends given to the
+child, so it holds at most two pipe descriptors and the children have nothing to close: the start is linear in the
+number of commands and long pipelines don't reach the limit of open files.
+The size of the pipes is chosen by PIPESIZE (see pipesize.h), in auto mode they grow while the shell waits.
+The CPUs, nice level and I/O priority of each child are chosen by CPUS, NICE and IOPRIO (see cpusched.h).
+A build in command is executed in the shell after the start of the others, with the file descriptors of its pipes
+(kept open until then); the other build in commands are executed in children.
 Return 0 if there is an error, else 1
 **************************************************************************************************************************/
-unsigned int runPipedCommands(queue * q, char **command, int n_arg, int numPipes)
+unsigned int runPipedCommands(const pipeline * pl)
 {
-	int status, *pipefds;
-	unsigned int i, first = 0, j = 0;
-	pid_t pid;
-	unsigned int redirect_Out = 0;	// 0 false - 1 true
-	int std_save;		// for ">" and "<"
-	unsigned int stdin_safe = dup(STDIN_FILENO);	// save stdin
-	unsigned int stdout_safe = dup(STDOUT_FILENO);	// save stdout
-	pipefds = (int *)malloc(sizeof(int) * (2 * numPipes));
-	for (i = 0; i < numPipes; i++)
-		if (pipe(pipefds + i * 2) == -1) {
-			perror("Errore in pipe\n");
-			close_pipe(&stdin_safe, &stdout_safe, numPipes, pipefds);
-			free(command);
-			return 0;
-		}
-	// check "<"
-	for (int k = 0; k < n_arg - 1; k++)	// check if bad positions
-		if (command[k][0] == '<') {
-			fprintf(stdout, RED "*** BAD COMMAND!!! ***" RESET_COLOR "\n");
-			close_pipe(&stdin_safe, &stdout_safe, numPipes, pipefds);
-			free(command);
-			return 0;
-		}
-	// check if there is to change the stdin
-	if (command[n_arg - 1][0] == '<') {
-		if (strlen(command[n_arg - 1]) == 1) {
-			fprintf(stdout, RED "*** BAD COMMAND!!! ***" RESET_COLOR "\n");
-			close_pipe(&stdin_safe, &stdout_safe, numPipes, pipefds);
-			return 0;
-		}
-		if ((std_save = openRedirInput(command[n_arg - 1])) == -1) {
-			free(pipefds);
-			free(command);
+	int numPipes = pl->n_comm - 1, i;
+	int fd_in, fd_out, redir_in, redir_out, unused;
+	int next_in = -2;		// read end of the last pipe, input of the next command
+	int pipefd[2], held[3], n_held;	// descriptors of the father that a forked build in has to close
+	int inproc_in = -2, inproc_out = -2;
+	int inproc = chooseInProcess(pl);	// command executed in the shell
+	const builtin **builtins;
+	pid_t *pids;
+	pipeSizing sizing;
+	lineSched sched;
+	stageSched st;
+	const stageSched *stage;
+	unsigned int ok = 1;
+	TRACE_START(start);
+	initPipeSizing(&sizing, numPipes);
+	initLineSched(&sched);
+	builtins = (const builtin **)arenaAlloc(&lineArena, sizeof(builtin *) * pl->n_comm);
+	pids = (pid_t *)arenaAlloc(&lineArena, sizeof(pid_t) * pl->n_comm);
+	for (i = 0; i < pl->n_comm; i++)	// unknown commands, no fork
+		if ((builtins[i] = findBuiltin(&pl->comm[i])) == NULL
+		    && commandPath(pl, i) == NULL)
 			return 0;
+	TRACE_SPAN(start, "resolve", NULL);
+	TRACE_START(redir);
+	if (!openRedirections(&pl->comm[0], &redir_in, &unused))
+		return 0;
+	if (!openRedirections(&pl->comm[numPipes], &unused, &redir_out)) {
+		closeRedirections(redir_in, -2);
+		return 0;
+	}
+	TRACE_SPAN(redir, "redirect", NULL);
+
+	for (i = 0; i < pl->n_comm; i++) {
+		fd_in = i == 0 ? redir_in : next_in;	// if i'm not in the first command
+		pipefd[0] = pipefd[1] = -2;
+		if (i < numPipes && pipe2(pipefd, O_CLOEXEC) == -1) {	// the pipe to the next command
+			perror("Errore in pipe\n");
+			ok = 0;
+		} else if (i < numPipes)
+			sizePipe(&sizing, i, pipefd[0]);
+		fd_out = i == numPipes ? redir_out : pipefd[1];	// if it isn't the last command
+		pids[i] = 0;
+		if (ok && i == inproc) {	// executed after the start of the others, its pipes stay open
+			inproc_in = fd_in;
+			inproc_out = fd_out;
+		} else if (ok) {
+			n_held = 0;	// a forked build in doesn't exec, so it closes by itself what isn't its
+			held[n_held++] = pipefd[0];
+			if (inproc >= 0 && inproc < i) {
+				held[n_held++] = inproc_in;
+				held[n_held++] = inproc_out;
+			}
+			TRACE_START(spawn);
+			stage = stageSchedule(&sched, i, pl->n_comm, &pl->comm[i], &st);
+			if (builtins[i] != NULL)
+				pids[i] = forkBuiltin(builtins[i], &pl->comm[i], fd_in, fd_out, held, n_held, stage);
+			else
+				pids[i] = spawnCommand(pl->paths[i], pl->comm[i].argv, commandEnv(pl->comm[i].assign, pl->comm[i].n_assign), fd_in, fd_out, NULL, 0, stage);
+			TRACE_SPAN(spawn, "spawn", pl->comm[i].argv[0]);
+			if (pids[i] == -1)
+				ok = 0;
+			else if (i < numPipes)
+				pipeWriter(&sizing, i, pids[i]);
+			if (i != 0 && fd_in >= 0)	// the ends given to the child
+				close(fd_in);
+			if (i != numPipes && fd_out >= 0)
+				close(fd_out);
 		}
-		n_arg--;
-		// if there is to change stdin
-		if (dup2(std_save, 0) == -1) {
-			perror("Error dup2 for output redirect in file\n");
-			close(std_save);
-			free(pipefds);
-			free(command);
+		next_in = pipefd[0];
+		if (!ok) {
+			if (pids[i] == 0 && i != 0 && fd_in >= 0)	// no pipe for this command, its input is still open
+				close(fd_in);
+			if (next_in >= 0)
+				close(next_in);
+			if (inproc >= 0 && inproc < i) {
+				if (inproc != 0)
+					close(inproc_in);
+				if (inproc != numPipes)
+					close(inproc_out);
+			}
+			closeRedirections(redir_in, redir_out);
+			wait_children_inPipe(i - 1, pids, NULL);
 			return 0;
 		}
-		if (close(std_save) == -1) {
-			free(pipefds);
-			free(command);
+	}
+
+	if (inproc >= 0) {
+		ok = execTimedBuiltin(pl, inproc, builtins[inproc], inproc_in, inproc_out);
+		if (inproc != 0)
+			close(inproc_in);
+		if (inproc != numPipes)
+			close(inproc_out);
+	}
+	// the redirections are closed after the build in, that can use them
+	closeRedirections(redir_in, redir_out);
+	if (pl->background)
+		return addJob(pids, pl->n_comm, pl->line);
+	// wait for each child and check if someone failed, the status of a build in as last command is kept
+	if (pl->times == NULL)	// "time" measures the end of each command, nothing is sampled
+		watchPipes(&sizing, pl->n_comm, pids);
+	pipeStats(&sizing);
+	if (inproc == numPipes) {
+		int status = lastStatus;
+		if (!wait_children_inPipe(numPipes, pids, pl->times))
 			return 0;
-		}
+		lastStatus = status;
+		return ok;
 	}
+	if (!wait_children_inPipe(numPipes, pids, pl->times))
+		return 0;
+	return 1;
+}
 
 
-	while (!isEmpty(q)) {
-		
-		while (!isEmpty(q) && j > 0) {
-			command = (char **)realloc(command, sizeof(char *) * (n_arg + 1));
-			char *singleArg;
-			singleArg = dequeue(q);
-			if (singleArg[0] == '|'){	// after pipe no more commands	
-				break;
-			}
+/**************************************************************************************************************************
+Execute the pipeline: build in command inside the shell, single command or commands with pipe.
+Return 0 if there is an error, else 1.
+**************************************************************************************************************************/
+unsigned int runCommand(const pipeline * pl)
+{
+	const builtin *b;
+	if (pl->n_comm > 1)
+		return runPipedCommands(pl);
+	if (pl->comm[0].argc == 0) {	// only assignments: variables of the shell
+		for (int i = 0; i < pl->comm[0].n_assign; i++)
+			if (!assignVar(pl->comm[0].assign[i], 0))
+				return 0;
+		return 1;
+	}
+	if (!pl->background && (b = findBuiltin(&pl->comm[0])) != NULL) {	// build in without fork
+		int fd_in, fd_out;
+		unsigned int ok;
+		if (!openRedirections(&pl->comm[0], &fd_in, &fd_out))
+			return 0;
+		ok = execTimedBuiltin(pl, 0, b, fd_in, fd_out);
+		return closeRedirections(fd_in, fd_out) && ok;
+	}
+	return execSingleCommand(pl);
+}
 
-			// check ">"
-			if (singleArg[0] == '>') {
-				redirect_Out = 1;
-				// take new stdout
-				if ((std_save = openRedirOutput(singleArg)) == -1) {
-					wait_children_inPipe(numPipes, &status, &pid);
-					close_pipe(&stdin_safe, &stdout_safe, numPipes, pipefds);
-					free(command);
-					return 0;
-				}
-				break;
-			}
-			command[n_arg] = singleArg;
-			n_arg++;
-		}
-		command = (char **)realloc(command, sizeof(char *) * (n_arg + 1));
-		command[n_arg] = NULL;	// for execvp
-		pid = fork();
-		if (pid == 0) {	// child process
-			// output
-			if (redirect_Out == 1) {
-				// if there is to change stdout
-				if (dup2(std_save, 1) == -1) {
-					perror("Error dup2 for output redirect in file\n");
-					close_pipe(&stdin_safe, &stdout_safe, numPipes, pipefds);
-					free(command);
-					return 0;
-				}
-				if (close(std_save) == -1) {
-					free(command);
-					free(pipefds);
-					return 0;
-				}
-			} else {
-				// if it isn't the last command
-				if (j < 2 * numPipes) {
-					if (dup2(pipefds[j + 1], 1) == -1) {
-						perror("Error dup2 output - PIPE\n");
-						close_pipe(&stdin_safe, &stdout_safe, numPipes, pipefds);
-						free(command);
-						return 0;
-					}
-				}
-			}
 
-			// input
-			// if i'm not in the first command
-			if (j != 0) {
-				if (dup2(pipefds[j - 2], 0) == -1) {
-					perror("Error dup2 input - PIPE\n");
-					close_pipe(&stdin_safe, &stdout_safe, numPipes, pipefds);
-					free(command);
-					return 0;
-				}
-			}
+/**************************************************************************************************************************
+Execute the pipeline, with "time" the resources used by each command are printed on stderr at the end.
+Return 0 if there is an error, else 1.
+**************************************************************************************************************************/
+unsigned int execCommand(const pipeline * pl)
+{
+	struct timespec start;
+	unsigned int ok;
+	TRACE_START(exec);
+	if (pl->times != NULL)
+		clock_gettime(CLOCK_MONOTONIC, &start);
+	ok = runCommand(pl);
+	if (pl->times != NULL) {
+		fflush(stdout);
+		printTimes(stderr, pl->times, pl->n_comm, &start);
+	}
+	TRACE_SPAN(exec, "execCommand", pl->comm[0].argv[0]);
+	return ok;
+}
 
-			// close all file descriptor
-			for (i = 0; i < 2 * numPipes; i++)
-				if (close(pipefds[i]) == -1)
-					break;
-
-			// execute instruction
-			if (execvp(command[first], command + first) == -1) {
-				fprintf(stdout, RED "*** BAD COMMAND!!! *** - Error of: %s" RESET_COLOR "\n", command[first]);
-				close_pipe(&stdin_safe, &stdout_safe, numPipes, pipefds);
-				free(command);
-				exit(EXIT_FAILURE);
-			}
 
-		} else if (pid < 0) {	// if fork return error
-			perror("Errore fork in pipe\n");
-			free(pipefds);
-			free(command);
+/**************************************************************************************************************************
+Check that no build in command that changes the shell is in a pipe or in background, that parallel is only the last
+command of a pipe and not in background, and that the build in commands have redirections only where accepted.
+Return 0 if there is an error, else 1.
+**************************************************************************************************************************/
+unsigned int checkBuiltins(const pipeline * pl)
+{
+	const builtin *b;
+	for (int i = 0; i < pl->n_comm; i++) {
+		if (pl->comm[i].argc == 0)	// only assignments
+			continue;
+		b = findBuiltin(&pl->comm[i]);
+		if (b != NULL && (((b->flags & BUILTIN_ALONE) && (pl->n_comm > 1 || pl->background))
+		    || ((b->flags & BUILTIN_LAST) && (i < pl->n_comm - 1 || pl->background))
+		    || ((b->flags & BUILTIN_NOREDIR) && pl->comm[i].n_redir > 0))) {	// cd with pipe or redirections
+			fprintf(stdout, RED "*** BAD COMMAND!!! ***" RESET_COLOR "\n");
 			return 0;
 		}
-		// father process
-		j += 2;
-		first = n_arg;
 	}
-
-	// closing all file descriptor opened by pipe
-	for (i = 0; i < 2 * numPipes; i++)
-		if (close(pipefds[i]) == -1)
-			break;
-	// wait for each child and check if someone failed, close pipe and reset stdin and stdout
-	if (!wait_children_inPipe(numPipes, &status, &pid)) {
-		free(pipefds);
-		free(command);
-		return 0;
-	}
-	if (!close_pipe(&stdin_safe, &stdout_safe, numPipes, pipefds)) {
-		free(command);
-		return 0;
-	}
-	free(command);
 	return 1;
 }
 
 
 /**************************************************************************************************************************
-Parse command and call function for single command, redirections and pipe.
+Build the pipeline taking the tokens from the queue and check that:
+ - every command has a name ("|" not at the start, at the end or after another "|");
+ - "<" and ">" are followed by the file name, "<<" by the end word and "<<<" by the string;
+ - "<", "<<" and "<<<" only in the first command and ">" only in the last one, at most one input and one output;
+ - no build in command that changes the shell with pipes or "&", and redirections only where accepted;
+ - "&" only at the end of the line.
+With expand the variables in the words are expanded, else they are expanded by expandPipeline before each execution
+(commands of for, while and if). The words "name=value" before a command are its assignments.
+A line starting with "time" saves the resources used by each command.
+The lines of the here-documents are read from the reader, their data is in a memfd closed by the parser.
 Return 0 if there is an error, else 1.
 **************************************************************************************************************************/
-unsigned int execCommand(queue * q, unsigned int num_pipe)
+unsigned int buildPipeline(queue * q, unsigned int num_pipe, pipeline * pl, reader * in, unsigned int expand)
 {
-	char *singleArg, *singleArg2;
-	int n_arg = 0, n_comm = 0;
-	char **commArray = NULL;
-	if (isEmpty(q))	// no commands
-		return 0;
-	while (!isEmpty(q)) {
-		commArray = (char **)realloc(commArray, sizeof(char *) * (n_arg + 1));
-		singleArg = dequeue(q);	// take arguments
-		if (strcmp(singleArg, "|") == 0) {	// check pipe
-			if (n_arg == 0) {	// no pipe in the first element
-				fprintf(stdout, RED "*** BAD COMMAND!!! ***" RESET_COLOR "\n");
-				free(commArray);
-				return 0;
-			}
-			n_comm++;
-			if (strcmp(commArray[0], "cd") == 0) {	// if cd and pipe
-				fprintf(stdout, RED "*** BAD COMMAND!!! ***" RESET_COLOR "\n");
-				free(commArray);
-				return 0;
-			}
-			if (!runPipedCommands(q, commArray, n_arg, num_pipe))	// execute pipe
-				return 0;
-			return 1;
-		} else if (singleArg[0] == '<' && !isEmpty(q) && num_pipe == 0) {	// if "<" then ">"
-			if (n_arg == 0) {
-				fprintf(stdout, RED "*** BAD COMMAND!!! ***" RESET_COLOR "\n");
-				free(commArray);
-				return 0;
-			}
-			n_comm++;
-			singleArg2 = dequeue(q);
-			if (!isEmpty(q)) {	// if more after "<file.extension >file.extension" it is an error
-				fprintf(stdout, RED "*** BAD COMMAND!!! ***" RESET_COLOR "\n");
-				free(commArray);
-				return 0;
-			}
-			if (singleArg2[0] == '>') {	// if ">"
-				n_comm++;
-				if (n_comm > 2) {
-					fprintf(stdout, RED "*** BAD COMMAND!!! ***" RESET_COLOR "\n");
-					free(commArray);
-					return 0;
-				}
-				if (strcmp(commArray[0], "cd") == 0) {	// if cd i have an error
+	unsigned int n_tok = size(q);
+	char **args;		// arguments of all the commands, each list ends with NULL
+	char **assigns;		// assignments of all the commands
+	redirect *redirs;	// redirections of all the commands
+	char *word;
+	command *cmd;
+	token t;
+	pl->n_comm = num_pipe + 1;
+	pl->background = 0;
+	pl->comm = (command *)arenaAlloc(&lineArena, sizeof(command) * pl->n_comm);
+	pl->times = NULL;
+	pl->paths = (const char **)arenaAlloc(&lineArena, sizeof(char *) * pl->n_comm);
+	memset(pl->paths, 0, sizeof(char *) * pl->n_comm);
+	if (peek(q, 0).type == WORD && strcmp(peek(q, 0).text, "time") == 0 && n_tok > 1) {	// "time" prefix
+		dequeue(q);
+		n_tok--;
+		pl->times = (stageTime *)arenaAlloc(&lineArena, sizeof(stageTime) * pl->n_comm);
+		memset(pl->times, 0, sizeof(stageTime) * pl->n_comm);
+	}
+	args = (char **)arenaAlloc(&lineArena, sizeof(char *) * (n_tok + pl->n_comm));
+	assigns = (char **)arenaAlloc(&lineArena, sizeof(char *) * n_tok);
+	redirs = (redirect *)arenaAlloc(&lineArena, sizeof(redirect) * (n_tok / 2 + 1));
+	for (int i = 0; i < pl->n_comm; i++) {
+		unsigned int n_in = 0, n_out = 0;
+		cmd = &pl->comm[i];
+		cmd->argv = args;
+		cmd->argc = 0;
+		cmd->assign = assigns;
+		cmd->n_assign = 0;
+		cmd->redir = redirs;
+		cmd->n_redir = 0;
+		while (!isEmpty(q) && (t = dequeue(q)).type != PIPE) {
+			if (t.type == BACKGROUND) {
+				if (!isEmpty(q)) {	// "&" not at the end
 					fprintf(stdout, RED "*** BAD COMMAND!!! ***" RESET_COLOR "\n");
-					free(commArray);
 					return 0;
 				}
-				int fd_out;	// change output
-				if ((fd_out = openRedirOutput(singleArg2)) == -1) {
-					free(commArray);
-					return 0;
-				}
-				int fd_in;	// change input
-				if ((fd_in = openRedirInput(singleArg)) == -1) {
-					free(commArray);
-					return 0;
-				}
-				pid_t child_pid;
-				commArray[n_arg] = NULL;	// for execvp
-				if ((child_pid = fork()) == -1) {
-					free(commArray);
-					return 0;
-				}
-				if (child_pid == 0) {	// child process
-					if (dup2(fd_in, STDIN_FILENO) == -1) {
-						perror("Error dup2 for input redirect\n");
-						free(commArray);
-						return 0;
-					}
-					if (dup2(fd_out, STDOUT_FILENO) == -1) {
-						perror("Error dup2 for output redirect\n");
-						free(commArray);
-						return 0;
-					}
-					execvp(commArray[0], commArray);	// execute command
-					fprintf(stdout, RED "*** BAD COMMAND!!! ***" RESET_COLOR "\n");
-					free(commArray);
-					exit(EXIT_FAILURE);
-				} else {	// father process
-					if (wait(NULL) == -1) {
-						free(commArray);
-						return 0;
-					}
-					if (close(fd_in) == -1) {
-						free(commArray);
-						return 0;
-					}
-					if (close(fd_out) == -1) {
-						free(commArray);
-						return 0;
-					}
-					free(commArray);
-				}
-			} else {
+				pl->background = 1;
+				continue;
+			}
+			if (t.type == WORD) {
+				word = expand ? expandWord(t.text) : t.text;
+				if (cmd->argc == 0 && nameLength(t.text) > 0 && t.text[nameLength(t.text)] == '=')
+					cmd->assign[cmd->n_assign++] = word;	// "name=value" before the command
+				else if (word == t.text || word[0] != '\0')	// a variable not set is not an argument
+					cmd->argv[cmd->argc++] = word;
+				continue;
+			}
+			// "<", ">", "<<" or "<<<" and the word
+			if (isEmpty(q) || peek(q, 0).type != WORD) {
 				fprintf(stdout, RED "*** BAD COMMAND!!! ***" RESET_COLOR "\n");
-				free(commArray);
 				return 0;
 			}
-			return 1;
-		} else if (singleArg[0] == '>' && !isEmpty(q) && num_pipe == 0) {	// if ">" then "<"
-			if (n_arg == 0) {
-				fprintf(stdout, RED "*** BAD COMMAND!!! ***" RESET_COLOR "\n");
-				free(commArray);
+			if (t.type == REDIR_OUT)
+				n_out++;
+			else
+				n_in++;
+			if ((t.type != REDIR_OUT && i != 0) || (t.type == REDIR_OUT && i != pl->n_comm - 1)) {
+				fprintf(stdout, RED "*** BAD COMMAND!!! ***" RESET_COLOR "\n");	// they would replace a pipe
 				return 0;
 			}
-			n_comm++;
-			singleArg2 = dequeue(q);
-			if (!isEmpty(q)) {	// if ">file.extension <file.extensione" there is an error
-				fprintf(stdout, RED "*** BAD COMMAND!!! ***" RESET_COLOR "\n");
-				free(commArray);
+			if (n_in > 1 || n_out > 1) {
+				fprintf(stdout, RED "*** BAD redirect %s ***" RESET_COLOR "\n", n_in > 1 ? "input" : "output");
 				return 0;
 			}
-			if (singleArg2[0] == '<') {	// "<"  
-				n_comm++;
-				if (n_comm > 2) {
-					fprintf(stdout, RED "*** BAD COMMAND!!! ***" RESET_COLOR "\n");
-					free(commArray);
-					return 0;
-				}
-				if (strcmp(commArray[0], "cd") == 0) {	// if cd there is an error
-					fprintf(stdout, RED "*** BAD COMMAND!!! ***" RESET_COLOR "\n");
-					free(commArray);
-					return 0;
-				}
-				int fd_out;	// change output
-				if ((fd_out = openRedirOutput(singleArg)) == -1) {
-					free(commArray);
-					return 0;
-				}
-				int fd_in;	// change input
-				if ((fd_in = openRedirInput(singleArg2)) == -1) {
-					free(commArray);
+			cmd->redir[cmd->n_redir].type = t.type;
+			cmd->redir[cmd->n_redir].fd = -1;
+			if (t.type == HEREDOC) {	// the end word isn't expanded
+				if ((cmd->redir[cmd->n_redir].file = readDocument(in, dequeue(q).text)) == NULL)
 					return 0;
-				}
-				pid_t child_pid;
-				commArray[n_arg] = NULL;	// for execvp
-				if ((child_pid = fork()) == -1) {
-					free(commArray);
-					return 0;
-				}
-				if (child_pid == 0) {	// child process
-					if (dup2(fd_in, STDIN_FILENO) == -1) {
-						perror("Error dup2 for input redirect\n");
-						free(commArray);
-						return 0;
-					}
-					if (dup2(fd_out, STDOUT_FILENO) == -1) {
-						perror("Error dup2 for output redirect\n");
-						free(commArray);
-						return 0;
-					}
-					execvp(commArray[0], commArray);	// execute command
-					fprintf(stdout, RED "*** BAD COMMAND!!! ***" RESET_COLOR "\n");
-					free(commArray);
-					exit(EXIT_FAILURE);
-				} else {	// father process
-					if (wait(NULL) == -1) {
-						free(commArray);
-						return 0;
-					}
-					if (close(fd_in) == -1) {
-						free(commArray);
-						return 0;
-					}
-					if (close(fd_out) == -1) {
-						free(commArray);
-						return 0;
-					}
-					free(commArray);
-				}
-			} else {
-				fprintf(stdout, RED "*** BAD COMMAND!!! ***" RESET_COLOR "\n");
-				free(commArray);
-				return 0;
-			}
-			return 1;
-		} else if (singleArg[0] == '<' && isEmpty(q)) {	// redirect input
-			if (n_arg == 0) {
-				fprintf(stdout, RED "*** BAD COMMAND!!! ***" RESET_COLOR "\n");
-				free(commArray);
+				if (expand)
+					cmd->redir[cmd->n_redir].fd = hereDocument(cmd->redir[cmd->n_redir].file);
+			} else if (expand) {
+				cmd->redir[cmd->n_redir].file = expandWord(dequeue(q).text);
+				if (t.type == HERESTRING)
+					cmd->redir[cmd->n_redir].fd = hereString(cmd->redir[cmd->n_redir].file);
+			} else
+				cmd->redir[cmd->n_redir].file = dequeue(q).text;
+			if (t.type != REDIR_IN && t.type != REDIR_OUT && expand && cmd->redir[cmd->n_redir].fd == -1)
 				return 0;
-			}
-			n_comm++;
-			if (n_comm > 2) {
-				fprintf(stdout, RED "*** BAD COMMAND!!! ***" RESET_COLOR "\n");
-				free(commArray);
-				return 0;
-			}
-			if (strcmp(commArray[0], "cd") == 0) {	// if cd
-				fprintf(stdout, RED "*** BAD COMMAND!!! ***" RESET_COLOR "\n");
-				free(commArray);
-				return 0;
-			}
-			if (n_comm != 1) {	// if "<" in the first command
-				fprintf(stdout, RED "*** BAD redirect input ***" RESET_COLOR "\n");
-				free(commArray);
-				return 0;
-			}
-			int fd_in;	// change input
-			if ((fd_in = openRedirInput(singleArg)) == -1) {
-				free(commArray);
-				return 0;
-			}
-			if (!execSingleCommand(commArray, n_arg, fd_in, -2)) {	// redirect input
-				close(fd_in);
-				free(commArray);
-				return 0;
-			}
-			if (close(fd_in) == -1) {
-				free(commArray);
-				return 0;
-			}
-			return 1;
-		} else if (singleArg[0] == '>') {	// redirect output
-			if (n_arg == 0) {
-				fprintf(stdout, RED "*** BAD COMMAND!!! ***" RESET_COLOR "\n");
-				free(commArray);
-				return 0;
-			}
-			n_comm++;
-			if (strcmp(commArray[0], "cd") == 0) {	// cd
-				fprintf(stdout, RED "*** BAD COMMAND!!! ***" RESET_COLOR "\n");
-				free(commArray);
-				return 0;
-			}
-			if (!isEmpty(q)) {	// check if ">" is last command
-				fprintf(stdout, RED "*** BAD redirect output ***" RESET_COLOR "\n");
-				free(commArray);
-				return 0;
-			}
-			int fd_out;	// change output
-			if ((fd_out = openRedirOutput(singleArg)) == -1) {
-				free(commArray);
-				return 0;
-			}
-			if (!execSingleCommand(commArray, n_arg, -2, fd_out)) {	// redirect output
-				close(fd_out);
-				free(commArray);
-				return 0;
-			}
-			if (close(fd_out) == -1) {
-				free(commArray);
-				return 0;
-			}
-			return 1;
+			cmd->n_redir++;
 		}
-		commArray[n_arg] = singleArg;
-		n_arg++;
+		if (cmd->argc == 0 && (cmd->n_assign == 0 || pl->n_comm > 1 || pl->background || cmd->n_redir > 0)) {
+			fprintf(stdout, RED "*** BAD COMMAND!!! ***" RESET_COLOR "\n");	// "|" without command or only redirections
+			return 0;
+		}
+		cmd->argv[cmd->argc] = NULL;	// for exec
+		args += cmd->argc + 1;
+		assigns += cmd->n_assign;
+		redirs += cmd->n_redir;
+		if (pl->times != NULL)
+			pl->times[i].name = cmd->argc > 0 ? cmd->argv[0] : cmd->assign[0];
 	}
-	// no "|" or "<" or ">" execute single command
-	if (strcmp(commArray[0], "cd") == 0) {	// if cd
-		if (n_arg == 1){
-			if (!cd(NULL, n_arg)) {
-				free(commArray);
-				return 0;	// fail
-			}
-		} else {
-			if (!cd(commArray[1], n_arg)) {
-				free(commArray);
-				return 0;	// fail
+	if (pl->background)	// "time" only for the commands waited by the shell
+		pl->times = NULL;
+	return checkBuiltins(pl);
+}
+
+
+/**************************************************************************************************************************
+Copy the pipeline built without expansion (commands of for, while and if) in out, expanding the variables in the
+arguments, assignments, file names and documents, and create the memfds of the here-documents and here-strings
+(closed by closeDocuments).
+Empty words made by the expansion are not arguments, the pipeline is checked again with the new names.
+Return 0 if there is an error, else 1.
+**************************************************************************************************************************/
+unsigned int expandPipeline(const pipeline * raw, pipeline * out)
+{
+	const command *cmd;
+	command *copy;
+	char *word;
+	*out = *raw;
+	out->comm = (command *)arenaAlloc(&lineArena, sizeof(command) * raw->n_comm);
+	out->paths = (const char **)arenaAlloc(&lineArena, sizeof(char *) * raw->n_comm);
+	memset(out->paths, 0, sizeof(char *) * raw->n_comm);
+	for (int i = 0; i < raw->n_comm; i++) {
+		cmd = &raw->comm[i];
+		copy = &out->comm[i];
+		*copy = *cmd;
+		copy->argv = (char **)arenaAlloc(&lineArena, sizeof(char *) * (cmd->argc + 1 + cmd->n_assign));
+		copy->argc = 0;
+		for (int j = 0; j < cmd->argc; j++)
+			if ((word = expandWord(cmd->argv[j])) == cmd->argv[j] || word[0] != '\0')
+				copy->argv[copy->argc++] = word;
+		copy->argv[copy->argc] = NULL;
+		copy->assign = copy->argv + copy->argc + 1;
+		for (int j = 0; j < cmd->n_assign; j++)
+			copy->assign[j] = expandWord(cmd->assign[j]);
+		copy->redir = (redirect *)arenaAlloc(&lineArena, sizeof(redirect) * (cmd->n_redir + 1));
+		for (int j = 0; j < cmd->n_redir; j++) {
+			copy->redir[j] = cmd->redir[j];
+			if (cmd->redir[j].type == HEREDOC)
+				copy->redir[j].fd = hereDocument(cmd->redir[j].file);
+			else {
+				copy->redir[j].file = expandWord(cmd->redir[j].file);
+				if (cmd->redir[j].type == HERESTRING)
+					copy->redir[j].fd = hereString(copy->redir[j].file);
+			}
+			if (cmd->redir[j].type != REDIR_IN && cmd->redir[j].type != REDIR_OUT && copy->redir[j].fd == -1) {
+				copy->n_redir = j;	// only the first command has documents
+				closeDocuments(out);
+				return 0;
 			}
 		}
-		free(commArray);
-	} else {
-		if (!execSingleCommand(commArray, n_arg, -2, -2)) {	// single command
-			free(commArray);
+		if (copy->argc == 0 && (copy->n_assign == 0 || out->n_comm > 1 || out->background || copy->n_redir > 0)) {
+			fprintf(stdout, RED "*** BAD COMMAND!!! ***" RESET_COLOR "\n");	// only empty variables
+			closeDocuments(out);
 			return 0;
 		}
 	}
+	if (raw->times != NULL) {
+		out->times = (stageTime *)arenaAlloc(&lineArena, sizeof(stageTime) * raw->n_comm);
+		memset(out->times, 0, sizeof(stageTime) * raw->n_comm);
+		for (int i = 0; i < raw->n_comm; i++)
+			out->times[i].name = out->comm[i].argc > 0 ? out->comm[i].argv[0] : out->comm[i].assign[0];
+	}
+	if (!checkBuiltins(out)) {
+		closeDocuments(out);
+		return 0;
+	}
 	return 1;
 }
 
 
 /**************************************************************************************************************************
-Parse input string.
+Close the memfds of the here-documents and here-strings, they are only in the first command.
+**************************************************************************************************************************/
+void closeDocuments(const pipeline * pl)
+{
+	for (int i = 0; i < pl->comm[0].n_redir; i++)
+		if (pl->comm[0].redir[i].fd >= 0)
+			close(pl->comm[0].redir[i].fd);
+}
+
+
+/**************************************************************************************************************************
+Execute the plan of a line found in the cache: the pipeline is already checked and its commands resolved, only the
+table of "time" is new.
 Return 0 if there is an error, else 1.
 **************************************************************************************************************************/
-unsigned int parser(char *complete_comm, queue * q)
+unsigned int execPlan(const pipeline * cached, unsigned int timed)
 {
-	unsigned int num_pipe = 0, i;
-	char *comm_token, *arg_token;
-	complete_comm[strlen(complete_comm) - 1] = 0;	// don't take \n in last position
-	for (i = 0; i < strlen(complete_comm); i++)	// remove tab
-		if (complete_comm[i] == '\t')
-			complete_comm[i] = ' ';
-	if(complete_comm[0] == '|' || complete_comm[strlen(complete_comm)-1] == '|'){
-		fprintf(stdout, RED "*** BAD COMMAND!!! ***" RESET_COLOR "\n");
-		return 0;
+	pipeline pl = *cached;
+	if (timed) {
+		pl.times = (stageTime *)arenaAlloc(&lineArena, sizeof(stageTime) * pl.n_comm);
+		memset(pl.times, 0, sizeof(stageTime) * pl.n_comm);
+		for (int i = 0; i < pl.n_comm; i++)
+			pl.times[i].name = pl.comm[i].argc > 0 ? pl.comm[i].argv[0] : pl.comm[i].assign[0];
 	}
-	while ((comm_token = strtok_r(complete_comm, "|", &complete_comm))) {	// divide for "|"
-		while ((arg_token = strtok_r(comm_token, " ", &comm_token))) {	// divide for spaces
-			if (arg_token[0] == '$') {	// if i have a '$'
-				if ((arg_token = environmentVar(arg_token)) == NULL)
-					return 0;
-			}
-			
-			enqueue(q, arg_token);
-		}
-		if (strlen(complete_comm) > 0) {	// pipe
-			enqueue(q, "|");
-			num_pipe++;
-		}
-		if (!checkErrorPipedCommand(q))	// redirect errors
-			return 0;
+	return execCommand(&pl);
+}
+
+
+/**************************************************************************************************************************
+Parse input string, the lines of the here-documents are read from the reader.
+A line already executed goes straight to the execution with its plan in the cache (see plancache.h), a line with
+for, while, if or ";" is compiled and executed by runScript.
+Return 0 if there is an error, else 1.
+**************************************************************************************************************************/
+unsigned int parser(char *complete_comm, queue * q, reader * in)
+{
+	unsigned int num_pipe, ok, timed = 0, pathGen, cwdGen, script = scriptLine(complete_comm);
+	size_t len = strcspn(complete_comm, "\n");
+	unsigned int cache = !script && !noExec && cacheableLine(complete_comm, len);
+	const pipeline *cached;
+	char *key = NULL;
+	pipeline pl;
+	TRACE_START(start);
+	if (cache && (cached = findPlan(complete_comm, len, &timed)) != NULL) {
+		TRACE_SPAN(start, "plan", NULL);
+		return execPlan(cached, timed);
 	}
-		
-	if (checkPipeError(q)) {	// more pipes errors
-		fprintf(stdout, RED "*** BAD COMMAND!!! ***" RESET_COLOR "\n");
-		return 0;
+	if (cache) {	// the lexer splits the line in place
+		key = (char *)arenaAlloc(&lineArena, len);
+		memcpy(key, complete_comm, len);
+	}
+	pl.line = NULL;
+	if (script || strstr(complete_comm, "<<") != NULL) {	// the tokens must survive the reading of the next lines
+		size_t size = strlen(complete_comm) + 1;
+		char *copy = (char *)arenaAlloc(&lineArena, size);
+		memcpy(copy, complete_comm, size);
+		complete_comm = copy;
+	}
+	if (strchr(complete_comm, '&') != NULL) {	// copy of the line for the job
+		size_t lineLen = strcspn(complete_comm, "\n");
+		pl.line = (char *)arenaAlloc(&lineArena, lineLen + 1);
+		memcpy(pl.line, complete_comm, lineLen);
+		pl.line[lineLen] = '\0';
 	}
-	if (!execCommand(q, num_pipe))	// execute command
+	if (!lexer(complete_comm, q, &num_pipe))	// tokens in the queue
 		return 0;
-	return 1;
+	TRACE_SPAN(start, "lexer", NULL);
+	if (script)
+		return runScript(q, in);
+	if (isEmpty(q))	// no commands
+		return 1;
+	TRACE_START(build);
+	pl.comm = NULL;
+	ok = buildPipeline(q, num_pipe, &pl, in, 1);	// syntax errors
+	TRACE_SPAN(build, "buildPipeline", NULL);
+	if (!ok || noExec) {
+		if (pl.comm != NULL)
+			closeDocuments(&pl);
+		return ok;
+	}
+	pathGen = shell.pathGen;
+	cwdGen = shell.cwdGen;
+	ok = execCommand(&pl);	// execute command
+	closeDocuments(&pl);
+	if (cache && pathGen == shell.pathGen && cwdGen == shell.cwdGen)	// the paths are still valid
+		storePlan(key, len, &pl, pl.times != NULL);
+	return ok;
 }
@@ -1,7 +1,40 @@
+#ifndef PARSING_H
+#define PARSING_H
+
 #include "queue.h"
+#include "arena.h"
+#include "timing.h"
+#include "reader.h"
+
+
+/**************************************************************************************************************************
+Pipeline built by the parser: commands with arguments (NULL terminated for exec) and redirections.
+All the memory is in lineArena.
+**************************************************************************************************************************/
+typedef struct {
+	tokenType type;	// REDIR_IN, REDIR_OUT, HEREDOC or HERESTRING
+	char *file;	// file name, end word of the here-document or the here-string
+	int fd;		// memfd with the data of HEREDOC and HERESTRING, else -1
+} redirect;
+
+typedef struct {
+	char **argv;
+	int argc;
+	char **assign;	// "name=value" written before the command, for its environment
+	int n_assign;
+	redirect *redir;
+	int n_redir;
+} command;
+
+typedef struct {
+	command *comm;
+	int n_comm;
+	unsigned int background;	// 1 if the line ends with "&"
+	char *line;			// command line, saved only for the jobs in background
+	stageTime *times;		// resources used by each command, only for a line starting with "time"
+	const char **paths;		// path of each command, resolved at the first execution (NULL for build in)
+} pipeline;
 
-#define MAXCOMM 1000	// max number of commands (example: "comm1 | comm2 | comm3 | ...")
-#define MAXCHARCOMM 1000	// Max length of char inside one command
 
 /**************************************************************************************************************************
 Colors
@@ -12,6 +45,71 @@ Colors
 #define RESET_COLOR "\x1b[0m"
 
 
+/**************************************************************************************************************************
+Exit status of the last executed command
+**************************************************************************************************************************/
+extern int lastStatus;
+
+
+/**************************************************************************************************************************
+Exit status of the previous command line, the value of $?
+**************************************************************************************************************************/
+extern int prevStatus;
+
+
+/**************************************************************************************************************************
+If 1 the commands are parsed and checked but not executed (ubash -n)
+**************************************************************************************************************************/
+extern unsigned int noExec;
+
+
+/**************************************************************************************************************************
+1 if the commands are typed on the terminal
+**************************************************************************************************************************/
+extern unsigned int interactive;
+
+
+/**************************************************************************************************************************
+Memory of the command line in execution: tokens, arguments and auxiliary queues. Released after each parser
+**************************************************************************************************************************/
+extern arena lineArena;
+
+
+/**************************************************************************************************************************
+Save the exit status of a child in lastStatus
+**************************************************************************************************************************/
+void saveStatus(int);
+
+
+/**************************************************************************************************************************
+Search the command in PATH before the fork.
+Return NULL if it doesn't exist (with error), else the absolute path
+**************************************************************************************************************************/
+const char *resolveCommand(const char *);
+
+
+/**************************************************************************************************************************
+Path of the command i of the pipeline, searched only the first time and remembered in the pipeline (and so in the
+plan cache).
+Return NULL if it doesn't exist (with error), else the absolute path
+**************************************************************************************************************************/
+const char *commandPath(const pipeline *, int);
+
+
+/**************************************************************************************************************************
+Open the redirections of the command in order, fd_in and fd_out are -2 if there isn't the redirection.
+Return 0 if there is an error (nothing remains open), else 1
+**************************************************************************************************************************/
+unsigned int openRedirections(const command *, int *, int *);
+
+
+/**************************************************************************************************************************
+Close the file descriptors opened by openRedirections.
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+unsigned int closeRedirections(int, int);
+
+
 /**************************************************************************************************************************
 Print current directory
 **************************************************************************************************************************/
@@ -19,14 +117,74 @@ void printCurDir();
 
 
 /**************************************************************************************************************************
-Take the input and check if there is a ctrl+D in the first row.
-Return 0 if there is a ctrl+D or errors.
+Take the next line from the reader, in interactive mode from the terminal with the line editor ("^D" is printed at
+the end) and it's added to the history. The line has no length limit and it's valid until the next call.
+Return NULL if there is a ctrl+D or errors, else the line
+**************************************************************************************************************************/
+char *inputCommand(reader *);
+
+
+/**************************************************************************************************************************
+Write the data in a new memfd (here-documents and here-strings), the file system is never used.
+Return -1 if there is an error, else the memfd at the start of the data
+**************************************************************************************************************************/
+int memoryFile(const char *, size_t);
+
+
+/**************************************************************************************************************************
+Read the lines of the here-document until the line equal to end, the variables are expanded later.
+Return NULL if there is an error, else the text of the document (in lineArena)
+**************************************************************************************************************************/
+char *readDocument(reader *, const char *);
+
+
+/**************************************************************************************************************************
+Expand the variables of the text of a here-document and write it in a new memfd.
+Return -1 if there is an error, else the memfd at the start of the data
+**************************************************************************************************************************/
+int hereDocument(char *);
+
+
+/**************************************************************************************************************************
+Write the word and '\n' in a new memfd, the input of a here-string.
+Return -1 if there is an error, else the memfd at the start of the data
+**************************************************************************************************************************/
+int hereString(const char *);
+
+
+/**************************************************************************************************************************
+Build the pipeline taking the tokens from the queue (num_pipe "|") and check it. With expand the variables are
+expanded, else they are expanded by expandPipeline before each execution.
+Return 0 if there is an error, else 1.
+**************************************************************************************************************************/
+unsigned int buildPipeline(queue *, unsigned int, pipeline *, reader *, unsigned int);
+
+
+/**************************************************************************************************************************
+Copy the pipeline built without expansion in out, expanding the variables and creating the memfds of the here-documents
+and here-strings (closed by closeDocuments).
+Return 0 if there is an error, else 1.
+**************************************************************************************************************************/
+unsigned int expandPipeline(const pipeline *, pipeline *);
+
+
+/**************************************************************************************************************************
+Close the memfds of the here-documents and here-strings, they are only in the first command.
 **************************************************************************************************************************/
-unsigned int inputCommand(char *);
+void closeDocuments(const pipeline *);
 
 
 /**************************************************************************************************************************
-Parse the string insert by user.
+Execute the pipeline, with "time" the resources used by each command are printed on stderr at the end.
+Return 0 if there is an error, else 1.
+**************************************************************************************************************************/
+unsigned int execCommand(const pipeline *);
+
+
+/**************************************************************************************************************************
+Parse the string insert by user, the lines of the here-documents are read from the reader.
 Return 0 if there is an error, else 1
 **************************************************************************************************************************/
-unsigned int parser(char *, queue *);
+unsigned int parser(char *, queue *, reader *);
+
+#endif
@@ -0,0 +1,184 @@
+#define _GNU_SOURCE
+
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include "pathcache.h"
+#include "parsing.h"
+#include "session.h"
+
+#define MINCACHEDIM 64	// initial number of slots of the table, always a power of 2
+
+
+/**************************************************************************************************************************
+Slot of the table: command name, absolute path and number of times it was used
+**************************************************************************************************************************/
+typedef struct {
+	char *name;
+	char *path;
+	unsigned int hits;
+} cacheEntry;
+
+static cacheEntry *table = NULL;
+static unsigned int tableDim = 0, tableUsed = 0;
+static unsigned int cachedGen = 0;	// generation of PATH when the table was filled
+
+
+/**************************************************************************************************************************
+FNV-1a hash of the string
+**************************************************************************************************************************/
+static unsigned int hashString(const char *s)
+{
+	unsigned int h = 2166136261u;
+	while (*s) {
+		h ^= (unsigned char)*s++;
+		h *= 16777619u;
+	}
+	return h;
+}
+
+
+/**************************************************************************************************************************
+Return the slot of the name (free slot if it isn't in the table), linear probing
+**************************************************************************************************************************/
+static cacheEntry *findSlot(cacheEntry *t, unsigned int dim, const char *name)
+{
+	unsigned int i = hashString(name) & (dim - 1);
+	while (t[i].name != NULL && strcmp(t[i].name, name) != 0)
+		i = (i + 1) & (dim - 1);
+	return &t[i];
+}
+
+
+/**************************************************************************************************************************
+Double the table when it is more than half full.
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+static unsigned int growTable()
+{
+	cacheEntry *newTable;
+	unsigned int newDim = tableDim == 0 ? MINCACHEDIM : tableDim * 2;
+	if ((newTable = calloc(newDim, sizeof(cacheEntry))) == NULL)
+		return 0;
+	for (unsigned int i = 0; i < tableDim; i++)
+		if (table[i].name != NULL)
+			*findSlot(newTable, newDim, table[i].name) = table[i];
+	free(table);
+	table = newTable;
+	tableDim = newDim;
+	return 1;
+}
+
+
+/**************************************************************************************************************************
+Empty the hash table of the commands
+**************************************************************************************************************************/
+void clearPathCache()
+{
+	for (unsigned int i = 0; i < tableDim; i++)
+		if (table[i].name != NULL) {
+			free(table[i].name);
+			free(table[i].path);
+			table[i].name = NULL;
+		}
+	tableUsed = 0;
+}
+
+
+/**************************************************************************************************************************
+Search the command in the directories of PATH.
+Return the malloc'd absolute path, NULL if it doesn't exist
+**************************************************************************************************************************/
+static char *searchPath(const char *name, const char *path)
+{
+	struct stat st;
+	size_t len = strlen(name);
+	char *file;
+	while (path != NULL) {
+		const char *end = strchrnul(path, ':');
+		size_t dirLen = end - path;
+		if ((file = malloc(dirLen + len + 3)) == NULL)
+			return NULL;
+		if (dirLen == 0)	// empty directory is the current one
+			sprintf(file, "./%s", name);
+		else
+			sprintf(file, "%.*s/%s", (int)dirLen, path, name);
+		if (stat(file, &st) == 0 && S_ISREG(st.st_mode) && access(file, X_OK) == 0)
+			return file;
+		free(file);
+		path = *end ? end + 1 : NULL;
+	}
+	return NULL;
+}
+
+
+/**************************************************************************************************************************
+Return the absolute path of the command searching the directories of PATH, NULL if it doesn't exist.
+The results are saved in a hash table, emptied when PATH changes (new generation of PATH in the session)
+**************************************************************************************************************************/
+const char *lookupCommand(const char *name)
+{
+	cacheEntry *slot;
+	char *file;
+	if (strchr(name, '/') != NULL)	// path of the file, no search
+		return access(name, X_OK) == 0 ? name : NULL;
+	if (cachedGen != shell.pathGen) {	// PATH changed
+		clearPathCache();
+		cachedGen = shell.pathGen;
+	}
+	if (tableDim > 0) {
+		slot = findSlot(table, tableDim, name);
+		if (slot->name != NULL) {
+			slot->hits++;
+			return slot->path;
+		}
+	}
+	if ((file = searchPath(name, shell.path)) == NULL)
+		return NULL;	// unknown commands are not remembered
+	if (2 * (tableUsed + 1) > tableDim && !growTable())
+		return file;
+	slot = findSlot(table, tableDim, name);
+	slot->name = strdup(name);
+	slot->path = file;
+	slot->hits = 1;
+	tableUsed++;
+	return file;
+}
+
+
+/**************************************************************************************************************************
+Build in hash command:
+ - hash		print the remembered commands;
+ - hash -r	forget all the commands;
+ - hash name...	search the commands and remember them.
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+unsigned int hashBuiltin(char **args, int num_arg, int fd_in, int fd_out)
+{
+	(void)fd_in;
+	(void)fd_out;
+	unsigned int ok = 1;
+	if (num_arg == 1) {
+		if (tableUsed == 0) {
+			fprintf(stdout, "hash: hash table empty\n");
+			return 1;
+		}
+		fprintf(stdout, "hits\tcommand\n");
+		for (unsigned int i = 0; i < tableDim; i++)
+			if (table[i].name != NULL)
+				fprintf(stdout, "%4u\t%s\n", table[i].hits, table[i].path);
+		return 1;
+	}
+	for (int i = 1; i < num_arg; i++) {
+		if (strcmp(args[i], "-r") == 0) {
+			clearPathCache();
+			shell.pathGen++;	// the plans of the cached lines forget their paths too
+		} else if (lookupCommand(args[i]) == NULL) {
+			fprintf(stdout, RED "micro-bash: hash: %s: not found" RESET_COLOR "\n", args[i]);
+			ok = 0;
+		}
+	}
+	return ok;
+}
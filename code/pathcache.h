@@ -0,0 +1,26 @@
+#ifndef PATHCACHE_H
+#define PATHCACHE_H
+
+/**************************************************************************************************************************
+Return the absolute path of the command searching the directories of PATH, NULL if it doesn't exist.
+The results are saved in a hash table, emptied when PATH changes
+**************************************************************************************************************************/
+const char *lookupCommand(const char *);
+
+
+/**************************************************************************************************************************
+Empty the hash table of the commands
+**************************************************************************************************************************/
+void clearPathCache();
+
+
+/**************************************************************************************************************************
+Build in hash command:
+ - hash		print the remembered commands;
+ - hash -r	forget all the commands;
+ - hash name...	search the commands and remember them.
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+unsigned int hashBuiltin(char **, int, int, int);
+
+#endif
@@ -0,0 +1,211 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "pipesize.h"
+#include "parsing.h"
+#include "variables.h"
+
+
+/**************************************************************************************************************************
+Max size of a pipe for a user without privileges, read once from /proc/sys/fs/pipe-max-size.
+Return the size in bytes
+**************************************************************************************************************************/
+static int maxPipeSize()
+{
+	static int max = 0;
+	FILE *f;
+	if (max > 0)
+		return max;
+	max = 1048576;	// default of the kernel
+	if ((f = fopen("/proc/sys/fs/pipe-max-size", "re")) != NULL) {
+		if (fscanf(f, "%d", &max) != 1 || max <= 0)
+			max = 1048576;
+		fclose(f);
+	}
+	return max;
+}
+
+
+/**************************************************************************************************************************
+Read a size in bytes, with k or m for KiB and MiB.
+Return 0 if it isn't a size, else 1
+**************************************************************************************************************************/
+static unsigned int parseSize(const char *s, int *size)
+{
+	char *end;
+	long n = strtol(s, &end, 10);
+	if (end == s || n <= 0)
+		return 0;
+	if (*end == 'k' || *end == 'K') {
+		n *= 1024;
+		end++;
+	} else if (*end == 'm' || *end == 'M') {
+		n *= 1024 * 1024;
+		end++;
+	}
+	if (*end != '\0' || n > INT_MAX)
+		return 0;
+	*size = (int)n;
+	return 1;
+}
+
+
+/**************************************************************************************************************************
+Read PIPESIZE and prepare the sizes of the n pipes of a pipeline (memory in lineArena).
+Return 0 if PIPESIZE is wrong (the kernel default is used), else 1
+**************************************************************************************************************************/
+unsigned int initPipeSizing(pipeSizing * ps, int n)
+{
+	const char *value = getVar("PIPESIZE");
+	unsigned int ok = 1;
+	ps->mode = PIPE_DEFAULT;
+	ps->n = n;
+	ps->grows = 0;
+	ps->stats = getenv("UBASH_STATS") != NULL;
+	ps->sizes = NULL;
+	if (value != NULL && value[0] != '\0') {
+		ps->max = maxPipeSize();
+		if (strcmp(value, "auto") == 0)
+			ps->mode = PIPE_AUTO;
+		else if (parseSize(value, &ps->size)) {
+			ps->mode = PIPE_FIXED;
+			if (ps->size > ps->max)
+				ps->size = ps->max;
+		} else {
+			fprintf(stdout, RED "micro-bash: PIPESIZE: %s: not a size or auto" RESET_COLOR "\n", value);
+			ok = 0;
+		}
+	}
+	if (ps->mode == PIPE_DEFAULT && !ps->stats)	// nothing to do for the pipes
+		return ok;
+	ps->sizes = (int *)arenaAlloc(&lineArena, sizeof(int) * n);
+	ps->writers = (pid_t *)arenaAlloc(&lineArena, sizeof(pid_t) * n);
+	ps->inodes = (ino_t *)arenaAlloc(&lineArena, sizeof(ino_t) * n);
+	memset(ps->sizes, 0, sizeof(int) * n);
+	memset(ps->writers, 0, sizeof(pid_t) * n);
+	return ok;
+}
+
+
+/**************************************************************************************************************************
+Set the size of the pipe i (fd is one of its ends), before the start of the commands that use it
+**************************************************************************************************************************/
+void sizePipe(pipeSizing * ps, int i, int fd)
+{
+	struct stat st;
+	if (ps->sizes == NULL)
+		return;
+	if (ps->mode != PIPE_FIXED || (ps->sizes[i] = fcntl(fd, F_SETPIPE_SZ, ps->size)) == -1)
+		ps->sizes[i] = fcntl(fd, F_GETPIPE_SZ);	// the kernel default or the size refused (limit of the user)
+	ps->inodes[i] = fstat(fd, &st) == 0 ? st.st_ino : 0;
+}
+
+
+/**************************************************************************************************************************
+Remember the command that writes in the pipe i
+**************************************************************************************************************************/
+void pipeWriter(pipeSizing * ps, int i, pid_t pid)
+{
+	if (ps->sizes != NULL)
+		ps->writers[i] = pid;
+}
+
+
+/**************************************************************************************************************************
+Double the pipe i if it's almost full (3/4 of its size), the pipe is opened again from the stdout of its writer.
+A pipe that can't grow more is not sampled again.
+**************************************************************************************************************************/
+static void growPipe(pipeSizing * ps, int i)
+{
+	char path[64];
+	struct stat st;
+	int fd, bytes, size;
+	snprintf(path, sizeof(path), "/proc/%d/fd/1", (int)ps->writers[i]);
+	if ((fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC)) == -1) {	// the writer has ended
+		ps->writers[i] = 0;
+		return;
+	}
+	if (fstat(fd, &st) == -1 || !S_ISFIFO(st.st_mode) || st.st_ino != ps->inodes[i])	// stdout isn't the pipe
+		ps->writers[i] = 0;
+	else if (ioctl(fd, FIONREAD, &bytes) == 0 && (long)bytes * 4 >= (long)ps->sizes[i] * 3) {
+		size = ps->sizes[i] > ps->max / 2 ? ps->max : 2 * ps->sizes[i];
+		if ((size = fcntl(fd, F_SETPIPE_SZ, size)) > ps->sizes[i]) {
+			ps->sizes[i] = size;
+			ps->grows++;
+		} else
+			ps->writers[i] = 0;	// limit of the user reached
+		if (ps->sizes[i] >= ps->max)
+			ps->writers[i] = 0;
+	}
+	close(fd);
+}
+
+
+/**************************************************************************************************************************
+Check without reaping them if some of the n pids (0 is skipped) is still running.
+Return 1 if a child is running, else 0
+**************************************************************************************************************************/
+static unsigned int running(int n, const pid_t *pids)
+{
+	siginfo_t info;
+	for (int i = 0; i < n; i++) {
+		if (pids[i] <= 0)
+			continue;
+		info.si_pid = 0;
+		if (waitid(P_PID, pids[i], &info, WEXITED | WNOHANG | WNOWAIT) == 0 && info.si_pid == 0)
+			return 1;
+	}
+	return 0;
+}
+
+
+/**************************************************************************************************************************
+In auto mode, sample the pipes until all the n pids (0 is skipped) end without reaping them: a pipe found full is
+doubled, up to the max size. The pipes are reached through /proc/pid/fd/1 of their writers.
+**************************************************************************************************************************/
+void watchPipes(pipeSizing * ps, int n, const pid_t *pids)
+{
+	struct timespec delay = { 0, PIPESAMPLE * 1000000L };
+	unsigned int sampled;
+	if (ps->mode != PIPE_AUTO)
+		return;
+	while (running(n, pids)) {
+		nanosleep(&delay, NULL);
+		sampled = 0;
+		for (int i = 0; i < ps->n; i++)
+			if (ps->writers[i] > 0) {
+				growPipe(ps, i);
+				sampled = 1;
+			}
+		if (!sampled)	// all the pipes are at their size
+			return;
+		if (delay.tv_nsec < PIPESAMPLEMAX * 1000000L / 2)
+			delay.tv_nsec *= 2;
+		else
+			delay.tv_nsec = PIPESAMPLEMAX * 1000000L;
+	}
+}
+
+
+/**************************************************************************************************************************
+Print the sizes of the pipes on stderr if UBASH_STATS is set
+**************************************************************************************************************************/
+void pipeStats(const pipeSizing * ps)
+{
+	static const char *modes[] = { "default", "fixed", "auto" };
+	if (!ps->stats || ps->sizes == NULL)
+		return;
+	fprintf(stderr, "pipes (%s):", modes[ps->mode]);
+	for (int i = 0; i < ps->n; i++)
+		fprintf(stderr, " %d", ps->sizes[i]);
+	fprintf(stderr, " bytes, %u grows\n", ps->grows);
+}
@@ -0,0 +1,62 @@
+#ifndef PIPESIZE_H
+#define PIPESIZE_H
+
+#include <sys/types.h>
+
+#define PIPE_DEFAULT 0	// size chosen by the kernel (64 KiB)
+#define PIPE_FIXED 1	// the size of PIPESIZE for all the pipes
+#define PIPE_AUTO 2	// the pipes that fill up are doubled while the pipeline runs
+
+#define PIPESAMPLE 1		// milliseconds between the first two samples of the pipes in auto mode
+#define PIPESAMPLEMAX 50	// max milliseconds between two samples, the interval doubles each time
+
+
+/**************************************************************************************************************************
+Buffer sizes of the pipes of a pipeline, chosen with the shell variable PIPESIZE: not set for the kernel default,
+a size in bytes (with k or m, example PIPESIZE=1m) or "auto"
+**************************************************************************************************************************/
+typedef struct {
+	unsigned int mode;
+	int size;		// size for PIPE_FIXED, first size for PIPE_AUTO
+	int max;		// /proc/sys/fs/pipe-max-size
+	int n;			// number of pipes
+	int *sizes;		// size of each pipe
+	pid_t *writers;		// command writing in each pipe (0 if it's executed in the shell)
+	ino_t *inodes;		// inode of each pipe, to recognize it in /proc
+	unsigned int grows;	// sizes doubled in auto mode
+	unsigned int stats;	// 1 if UBASH_STATS is set
+} pipeSizing;
+
+
+/**************************************************************************************************************************
+Read PIPESIZE and prepare the sizes of the n pipes of a pipeline (memory in lineArena).
+Return 0 if PIPESIZE is wrong (the kernel default is used), else 1
+**************************************************************************************************************************/
+unsigned int initPipeSizing(pipeSizing *, int);
+
+
+/**************************************************************************************************************************
+Set the size of the pipe i (fd is one of its ends), before the start of the commands that use it
+**************************************************************************************************************************/
+void sizePipe(pipeSizing *, int, int);
+
+
+/**************************************************************************************************************************
+Remember the command that writes in the pipe i
+**************************************************************************************************************************/
+void pipeWriter(pipeSizing *, int, pid_t);
+
+
+/**************************************************************************************************************************
+In auto mode, sample the pipes until all the n pids (0 is skipped) end without reaping them: a pipe found full is
+doubled, up to the max size. The pipes are reached through /proc/pid/fd/1 of their writers.
+**************************************************************************************************************************/
+void watchPipes(pipeSizing *, int, const pid_t *);
+
+
+/**************************************************************************************************************************
+Print the sizes of the pipes on stderr if UBASH_STATS is set
+**************************************************************************************************************************/
+void pipeStats(const pipeSizing *);
+
+#endif
@@ -0,0 +1,244 @@
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include "plancache.h"
+#include "session.h"
+#include "builtins.h"
+
+
+/**************************************************************************************************************************
+Plan of a command line: the line is the key, the pipeline and all its memory (commands, arguments, redirections and
+paths) are in the same malloc'd block after the struct
+**************************************************************************************************************************/
+typedef struct {
+	char *line;
+	size_t len;
+	unsigned int hash;
+	unsigned int timed;	// the line starts with "time"
+	pipeline pl;
+} plan;
+
+static plan **table = NULL;
+static unsigned int tableDim = 0, tableUsed = 0;
+static unsigned int cachedPathGen = 0, cachedCwdGen = 0;	// PATH and directory when the plans were saved
+static unsigned long hits = 0, misses = 0, uncached = 0, invalidations = 0;
+
+
+/**************************************************************************************************************************
+FNV-1a hash of the len characters
+**************************************************************************************************************************/
+static unsigned int hashLine(const char *s, size_t len)
+{
+	unsigned int h = 2166136261u;
+	for (size_t i = 0; i < len; i++) {
+		h ^= (unsigned char)s[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+
+/**************************************************************************************************************************
+Return the slot of the line (free slot if it isn't in the table), linear probing
+**************************************************************************************************************************/
+static plan **findSlot(plan **t, unsigned int dim, const char *line, size_t len, unsigned int h)
+{
+	unsigned int i = h & (dim - 1);
+	while (t[i] != NULL && (t[i]->hash != h || t[i]->len != len || memcmp(t[i]->line, line, len) != 0))
+		i = (i + 1) & (dim - 1);
+	return &t[i];
+}
+
+
+/**************************************************************************************************************************
+Free all the plans, the table is kept
+**************************************************************************************************************************/
+static void clearPlans()
+{
+	for (unsigned int i = 0; i < tableDim; i++) {
+		free(table[i]);
+		table[i] = NULL;
+	}
+	tableUsed = 0;
+}
+
+
+/**************************************************************************************************************************
+Empty the table if PATH or the current directory changed after the plans were saved
+**************************************************************************************************************************/
+static void checkGenerations()
+{
+	if (cachedPathGen == shell.pathGen && cachedCwdGen == shell.cwdGen)
+		return;
+	if (tableUsed > 0) {
+		clearPlans();
+		invalidations++;
+	}
+	cachedPathGen = shell.pathGen;
+	cachedCwdGen = shell.cwdGen;
+}
+
+
+/**************************************************************************************************************************
+Double the table when it is more than half full.
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+static unsigned int growTable()
+{
+	plan **newTable;
+	unsigned int newDim = tableDim == 0 ? MINPLANDIM : tableDim * 2;
+	if ((newTable = calloc(newDim, sizeof(plan *))) == NULL)
+		return 0;
+	for (unsigned int i = 0; i < tableDim; i++)
+		if (table[i] != NULL)
+			*findSlot(newTable, newDim, table[i]->line, table[i]->len, table[i]->hash) = table[i];
+	free(table);
+	table = newTable;
+	tableDim = newDim;
+	return 1;
+}
+
+
+/**************************************************************************************************************************
+Check if the plan of the line (len characters, without '\n') can be cached: the line doesn't expand variables ("$")
+and doesn't read here-documents or here-strings ("<<").
+Return 1 if it can be cached, else 0
+**************************************************************************************************************************/
+unsigned int cacheableLine(const char *line, size_t len)
+{
+	if (memchr(line, '$', len) == NULL && memmem(line, len, "<<", 2) == NULL)
+		return 1;
+	uncached++;
+	return 0;
+}
+
+
+/**************************************************************************************************************************
+Search the plan of the line (len characters, without '\n'): the pipeline already checked, with the paths of the
+commands. The table is emptied when PATH or the current directory change.
+Return NULL if it isn't in the cache, else the pipeline (read only, times must be allocated by the caller)
+**************************************************************************************************************************/
+const pipeline *findPlan(const char *line, size_t len, unsigned int *timed)
+{
+	plan *p;
+	checkGenerations();
+	if (tableUsed == 0 || (p = *findSlot(table, tableDim, line, len, hashLine(line, len))) == NULL) {
+		misses++;
+		return NULL;
+	}
+	hits++;
+	*timed = p->timed;
+	return &p->pl;
+}
+
+
+/**************************************************************************************************************************
+Copy the string at the position *next of the block.
+Return the copy
+**************************************************************************************************************************/
+static char *copyString(char **next, const char *s, size_t len)
+{
+	char *copy = *next;
+	memcpy(copy, s, len);
+	copy[len] = '\0';
+	*next += len + 1;
+	return copy;
+}
+
+
+/**************************************************************************************************************************
+Save a copy of the executed pipeline as the plan of the line (len characters, without '\n'), if the path of every
+command is resolved. timed is 1 if the line starts with "time"
+**************************************************************************************************************************/
+void storePlan(const char *line, size_t len, const pipeline * pl, unsigned int timed)
+{
+	size_t pointers = 0, chars = len + 1, redirs = 0;
+	unsigned int h = hashLine(line, len);
+	char **nextPtr, *next;
+	plan *p, **slot;
+	redirect *r;
+	checkGenerations();
+	for (int i = 0; i < pl->n_comm; i++) {	// dimension of the block
+		const command *cmd = &pl->comm[i];
+		if (cmd->argc > 0 && pl->paths[i] == NULL && findBuiltin(cmd) == NULL)	// not resolved
+			return;
+		pointers += cmd->argc + 1 + cmd->n_assign;
+		redirs += cmd->n_redir;
+		for (int j = 0; j < cmd->argc; j++)
+			chars += strlen(cmd->argv[j]) + 1;
+		for (int j = 0; j < cmd->n_assign; j++)
+			chars += strlen(cmd->assign[j]) + 1;
+		for (int j = 0; j < cmd->n_redir; j++)
+			chars += strlen(cmd->redir[j].file) + 1;
+		if (pl->paths[i] != NULL)
+			chars += strlen(pl->paths[i]) + 1;
+	}
+	if (tableUsed >= MAXPLANS)	// lines never repeated fill the table
+		clearPlans();
+	if (2 * (tableUsed + 1) > tableDim && !growTable())
+		return;
+	slot = findSlot(table, tableDim, line, len, h);
+	if (*slot != NULL)
+		return;
+	if ((p = malloc(sizeof(plan) + pl->n_comm * (sizeof(command) + sizeof(char *)) + redirs * sizeof(redirect)
+			+ pointers * sizeof(char *) + chars)) == NULL)
+		return;
+	// pointer aligned data first, then the strings
+	p->pl = *pl;
+	p->pl.comm = (command *)(p + 1);
+	p->pl.paths = (const char **)(p->pl.comm + pl->n_comm);
+	p->pl.times = NULL;
+	r = (redirect *)(p->pl.paths + pl->n_comm);
+	nextPtr = (char **)(r + redirs);
+	next = (char *)(nextPtr + pointers);
+	p->line = copyString(&next, line, len);
+	p->len = len;
+	p->hash = h;
+	p->timed = timed;
+	p->pl.line = pl->line != NULL ? p->line : NULL;
+	for (int i = 0; i < pl->n_comm; i++) {
+		const command *cmd = &pl->comm[i];
+		command *copy = &p->pl.comm[i];
+		*copy = *cmd;
+		copy->argv = nextPtr;
+		for (int j = 0; j < cmd->argc; j++)
+			copy->argv[j] = copyString(&next, cmd->argv[j], strlen(cmd->argv[j]));
+		copy->argv[cmd->argc] = NULL;
+		copy->assign = copy->argv + cmd->argc + 1;
+		for (int j = 0; j < cmd->n_assign; j++)
+			copy->assign[j] = copyString(&next, cmd->assign[j], strlen(cmd->assign[j]));
+		nextPtr = copy->assign + cmd->n_assign;
+		copy->redir = r;
+		for (int j = 0; j < cmd->n_redir; j++) {
+			r[j] = cmd->redir[j];
+			r[j].file = copyString(&next, cmd->redir[j].file, strlen(cmd->redir[j].file));
+		}
+		r += cmd->n_redir;
+		p->pl.paths[i] = pl->paths[i] != NULL ? copyString(&next, pl->paths[i], strlen(pl->paths[i])) : NULL;
+	}
+	*slot = p;
+	tableUsed++;
+}
+
+
+/**************************************************************************************************************************
+Free all the plans
+**************************************************************************************************************************/
+void freePlans()
+{
+	clearPlans();
+	free(table);
+	table = NULL;
+	tableDim = 0;
+}
+
+
+/**************************************************************************************************************************
+Print the counters of the plan cache (hits, misses, lines not cacheable, invalidations) on the stream
+**************************************************************************************************************************/
+void planStats(FILE * out)
+{
+	fprintf(out, "plans: %lu hits, %lu misses, %lu not cacheable, %lu invalidations, %u plans\n",
+		hits, misses, uncached, invalidations, tableUsed);
+}
@@ -0,0 +1,46 @@
+#ifndef PLANCACHE_H
+#define PLANCACHE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "parsing.h"
+
+#define MINPLANDIM 64	// initial number of slots of the table, always a power of 2
+#define MAXPLANS 4096	// plans kept at most, the table is emptied when it's full
+
+
+/**************************************************************************************************************************
+Check if the plan of the line (len characters, without '\n') can be cached: the line doesn't expand variables ("$")
+and doesn't read here-documents or here-strings ("<<").
+Return 1 if it can be cached, else 0
+**************************************************************************************************************************/
+unsigned int cacheableLine(const char *, size_t);
+
+
+/**************************************************************************************************************************
+Search the plan of the line (len characters, without '\n'): the pipeline already checked, with the paths of the
+commands. The table is emptied when PATH or the current directory change.
+Return NULL if it isn't in the cache, else the pipeline (read only, times must be allocated by the caller)
+**************************************************************************************************************************/
+const pipeline *findPlan(const char *, size_t, unsigned int *);
+
+
+/**************************************************************************************************************************
+Save a copy of the executed pipeline as the plan of the line (len characters, without '\n'), if the path of every
+command is resolved. timed is 1 if the line starts with "time"
+**************************************************************************************************************************/
+void storePlan(const char *, size_t, const pipeline *, unsigned int);
+
+
+/**************************************************************************************************************************
+Free all the plans
+**************************************************************************************************************************/
+void freePlans();
+
+
+/**************************************************************************************************************************
+Print the counters of the plan cache (hits, misses, lines not cacheable, invalidations) on the stream
+**************************************************************************************************************************/
+void planStats(FILE *);
+
+#endif
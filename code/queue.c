@@ -2,72 +2,114 @@
 
 
 /**************************************************************************************************************************
-Create queue with dimension dim.
+Create queue with dimension dim (rounded to a power of 2, inline if it's small).
 **************************************************************************************************************************/
 void create(queue * q, unsigned int dim)
 {
-	q->array = malloc(dim * sizeof(char *));
+	unsigned int pow2 = QUEUEINLINE;
+	q->array = q->inlineArray;
+	q->dim = QUEUEINLINE;
 	q->first = 0;
-	q->last = 0;
+	q->count = 0;
+	if (dim <= QUEUEINLINE)
+		return;
+	while (pow2 < dim)
+		pow2 *= 2;
+	if ((q->array = malloc(pow2 * sizeof(token))) == NULL) {	// the inline array is still usable
+		q->array = q->inlineArray;
+		return;
+	}
+	q->dim = pow2;
 }
 
 
 /**************************************************************************************************************************
-Empty the queue
+Empty the queue and free its memory
 **************************************************************************************************************************/
 void reset(queue * q)
 {
-	free(q->array);
+	if (q->array != q->inlineArray)
+		free(q->array);
+	q->array = q->inlineArray;
+	q->dim = QUEUEINLINE;
 	q->first = 0;
-	q->last = 0;
+	q->count = 0;
+}
+
+
+/**************************************************************************************************************************
+Empty the queue keeping its memory, so it can be reused for the next command
+**************************************************************************************************************************/
+void clear(queue * q)
+{
+	q->first = 0;
+	q->count = 0;
 }
 
 
 /**************************************************************************************************************************
 Return 1 if it's empty, else 0
 **************************************************************************************************************************/
-unsigned int isEmpty(queue * q)
+unsigned int isEmpty(const queue * q)
+{
+	return q->count == 0;
+}
+
+
+/**************************************************************************************************************************
+Double the buffer, the elements are copied in order from the start.
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+static unsigned int grow(queue * q)
 {
-	if (q->first == q->last)
-		return 1;
-	return 0;
+	token *newArray;
+	if ((newArray = malloc(2 * q->dim * sizeof(token))) == NULL)
+		return 0;
+	for (unsigned int i = 0; i < q->count; i++)
+		newArray[i] = q->array[(q->first + i) & (q->dim - 1)];
+	if (q->array != q->inlineArray)
+		free(q->array);
+	q->array = newArray;
+	q->dim *= 2;
+	q->first = 0;
+	return 1;
 }
 
 
 /**************************************************************************************************************************
-Add element in queue
+Add element in queue, the queue grows when it is full.
+Return 0 if there is an error, else 1
 **************************************************************************************************************************/
-void enqueue(queue * q, char *str)
+unsigned int enqueue(queue * q, token t)
 {
-	q->array[q->last] = str;
-	q->last++;
+	if (q->count == q->dim && !grow(q))
+		return 0;
+	q->array[(q->first + q->count) & (q->dim - 1)] = t;
+	q->count++;
+	return 1;
 }
 
 
 /**************************************************************************************************************************
 Take first element of queue 
 **************************************************************************************************************************/
-char *dequeue(queue * q)
+token dequeue(queue * q)
 {
-	q->first++;
-	return q->array[q->first - 1];
+	token t = q->array[q->first];
+	q->first = (q->first + 1) & (q->dim - 1);
+	q->count--;
+	return t;
 }
 
 
 /**************************************************************************************************************************
-Return 1 if in the queue there are two | consecutive, else return 0
+Return the element i of the queue (0 is the first) without taking it, a token with NULL text if there isn't
 **************************************************************************************************************************/
-unsigned int checkPipeError(const queue * q)
+token peek(const queue * q, unsigned int i)
 {
-	for (int i = q->first; i < q->last - 1; i++) {
-		if (q->array[i][0] == '|' && q->array[i + 1][0] == '|')
-			return 1;
-		if (q->array[i][0] == '|' && (q->array[i + 1][0] == '<' || q->array[i + 1][0] == '>'))
-			return 1;
-	}
-	if(q->array[q->last-1][0] == '|')
-		return 1;
-	return 0;
+	if (i >= q->count)
+		return (token) { WORD, NULL };
+	return q->array[(q->first + i) & (q->dim - 1)];
 }
 
 
@@ -76,19 +118,30 @@ Return number of elements in the queue
 **************************************************************************************************************************/
 unsigned int size(const queue * q)
 {
-	return (q->last - q->first);
+	return q->count;
+}
+
+
+/**************************************************************************************************************************
+Start a cursor on the first element of the queue
+**************************************************************************************************************************/
+void cursorInit(queueCursor * c, const queue * q)
+{
+	c->q = q;
+	c->pos = 0;
 }
 
 
 /**************************************************************************************************************************
-Copy q into q2
+Read the element of the cursor in t and move the cursor to the next one.
+Return 0 at the end of the queue, else 1
 **************************************************************************************************************************/
-void copyQueue(const queue * q, queue * q2)
+unsigned int cursorNext(queueCursor * c, token * t)
 {
-	unsigned int length;
-	length = size(q);
-	for (unsigned int i = 0; i < length; i++)
-		enqueue(q2, q->array[i]);
+	if (c->pos >= c->q->count)
+		return 0;
+	*t = peek(c->q, c->pos++);
+	return 1;
 }
 
 
@@ -97,7 +150,9 @@ Print the queue
 **************************************************************************************************************************/
 void printQueue(const queue * q)
 {
-	unsigned int i;
-	for (i = q->first; i < q->last; i++)
-		fprintf(stdout, "%s\n", q->array[i]);
+	queueCursor c;
+	token t;
+	cursorInit(&c, q);
+	while (cursorNext(&c, &t))
+		fprintf(stdout, "%s\n", t.text);
 }
@@ -1,52 +1,94 @@
+#ifndef QUEUE_H
+#define QUEUE_H
+
 #include <stdlib.h>
 #include <stdio.h>
 
-#define MAXQUEUEELEM 1000	// Max elem number in the queue
+#define QUEUEINLINE 16	// elements kept inside the queue struct, a command line has few tokens
 
 
 /**************************************************************************************************************************
-Queue Struct.
+Token Struct: type and text (inside the command line) of a token found by the lexer.
 **************************************************************************************************************************/
+typedef enum {
+	WORD,		// command, argument or file name
+	PIPE,		// "|"
+	REDIR_IN,	// "<"
+	REDIR_OUT,	// ">"
+	HEREDOC,	// "<<" followed by the word that ends the document
+	HERESTRING,	// "<<<" followed by the word used as input
+	BACKGROUND,	// "&"
+	SEMICOLON	// ";" or the end of a line inside for, while and if
+} tokenType;
+
 typedef struct {
-	char **array;
-	int last, first;
+	tokenType type;
+	char *text;
+} token;
+
+
+/**************************************************************************************************************************
+Queue Struct: ring buffer of dim tokens (a power of 2) from first, the tokens are in the inline array until they are
+more than QUEUEINLINE, then the buffer is on the heap and it doubles when it is full.
+**************************************************************************************************************************/
+typedef struct {
+	token *array;
+	unsigned int first, count;
+	unsigned int dim;
+	token inlineArray[QUEUEINLINE];
 } queue;
 
 
 /**************************************************************************************************************************
-Create queue with dimension dim.
+Read only cursor of the queue, the tokens are read without taking them
+**************************************************************************************************************************/
+typedef struct {
+	const queue *q;
+	unsigned int pos;
+} queueCursor;
+
+
+/**************************************************************************************************************************
+Create queue with dimension dim (rounded to a power of 2, inline if it's small).
 **************************************************************************************************************************/
 void create(queue *, unsigned int);
 
 
 /**************************************************************************************************************************
-Empty the queue
+Empty the queue and free its memory
 **************************************************************************************************************************/
 void reset(queue *);
 
 
+/**************************************************************************************************************************
+Empty the queue keeping its memory, so it can be reused for the next command
+**************************************************************************************************************************/
+void clear(queue *);
+
+
 /**************************************************************************************************************************
 Return 1 if it's empty, else 0
 **************************************************************************************************************************/
-unsigned int isEmpty(queue *);
+unsigned int isEmpty(const queue *);
 
 
 /**************************************************************************************************************************
-Add element in queue
+Add element in queue, the queue grows when it is full.
+Return 0 if there is an error, else 1
 **************************************************************************************************************************/
-void enqueue(queue *, char *);
+unsigned int enqueue(queue *, token);
 
 
 /**************************************************************************************************************************
 Take first element of queue 
 **************************************************************************************************************************/
-char *dequeue(queue *);
+token dequeue(queue *);
 
 
 /**************************************************************************************************************************
-Return 1 if in the queue there are two | consecutive, else return 0
+Return the element i of the queue (0 is the first) without taking it, a token with NULL text if there isn't
 **************************************************************************************************************************/
-unsigned int checkPipeError(const queue *);
+token peek(const queue *, unsigned int);
 
 
 /**************************************************************************************************************************
@@ -56,12 +98,21 @@ unsigned int size(const queue *);
 
 
 /**************************************************************************************************************************
-Copy q into q2
+Start a cursor on the first element of the queue
 **************************************************************************************************************************/
-void copyQueue(const queue *, queue *);
+void cursorInit(queueCursor *, const queue *);
+
+
+/**************************************************************************************************************************
+Read the element of the cursor in t and move the cursor to the next one.
+Return 0 at the end of the queue, else 1
+**************************************************************************************************************************/
+unsigned int cursorNext(queueCursor *, token *);
 
 
 /**************************************************************************************************************************
 Print the queue
 **************************************************************************************************************************/
 void printQueue(const queue *);
+
+#endif
@@ -0,0 +1,101 @@
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include "reader.h"
+
+
+/**************************************************************************************************************************
+Create the reader of the file descriptor with a buffer of dim bytes.
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+unsigned int openReader(reader * r, int fd, size_t dim)
+{
+	r->fd = fd;
+	r->dim = dim;
+	r->start = r->end = r->scanned = 0;
+	r->eof = 0;
+	return (r->buf = malloc(dim)) != NULL;
+}
+
+
+/**************************************************************************************************************************
+Create the reader of the lines of the string (copied).
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+unsigned int stringReader(reader * r, const char *s)
+{
+	size_t len = strlen(s);
+	if (!openReader(r, -1, len + 1))
+		return 0;
+	memcpy(r->buf, s, len);
+	r->end = len;
+	r->eof = 1;
+	return 1;
+}
+
+
+/**************************************************************************************************************************
+Read more input after the data not returned, moving it at the start of the buffer and doubling the buffer when it is
+full (one byte is always free for the '\0' of the last line).
+Return 0 at the end of the input or if there is an error, else 1
+**************************************************************************************************************************/
+static unsigned int fill(reader * r)
+{
+	ssize_t n;
+	if (r->start > 0) {	// the lines already returned are dropped
+		memmove(r->buf, r->buf + r->start, r->end - r->start);
+		r->end -= r->start;
+		r->scanned -= r->start;
+		r->start = 0;
+	}
+	if (r->end + 1 >= r->dim) {
+		char *newBuf;
+		if ((newBuf = realloc(r->buf, r->dim * 2)) == NULL)
+			return 0;
+		r->buf = newBuf;
+		r->dim *= 2;
+	}
+	while ((n = read(r->fd, r->buf + r->end, r->dim - r->end - 1)) == -1 && errno == EINTR)
+		;
+	if (n <= 0)
+		return 0;
+	r->end += n;
+	return 1;
+}
+
+
+/**************************************************************************************************************************
+Return the next line, valid until the next call, and its length in len (it can be NULL).
+Return NULL at the end of the input or if there is an error
+**************************************************************************************************************************/
+char *nextLine(reader * r, size_t *len)
+{
+	char *nl, *line;
+	while ((nl = memchr(r->buf + r->scanned, '\n', r->end - r->scanned)) == NULL) {
+		r->scanned = r->end;
+		if (r->eof || !fill(r)) {	// last line without '\n'
+			r->eof = 1;
+			if (r->start == r->end)
+				return NULL;
+			nl = r->buf + r->end;
+			break;
+		}
+	}
+	*nl = '\0';
+	line = r->buf + r->start;
+	if (len != NULL)
+		*len = nl - line;
+	r->start = r->scanned = nl < r->buf + r->end ? (size_t)(nl - r->buf) + 1 : r->end;
+	return line;
+}
+
+
+/**************************************************************************************************************************
+Free the buffer of the reader, the file descriptor isn't closed
+**************************************************************************************************************************/
+void closeReader(reader * r)
+{
+	free(r->buf);
+	r->buf = NULL;
+}
@@ -0,0 +1,47 @@
+#ifndef READER_H
+#define READER_H
+
+#include <stddef.h>
+
+
+/**************************************************************************************************************************
+Reader of command lines: the input is read in large blocks in a buffer that grows for long lines, the lines are
+returned inside the buffer (no copy) with '\0' in place of '\n'
+**************************************************************************************************************************/
+typedef struct {
+	int fd;			// -1 if the input is a string
+	char *buf;
+	size_t dim;
+	size_t start, end;	// data not returned yet
+	size_t scanned;		// data already searched for '\n'
+	unsigned int eof;
+} reader;
+
+
+/**************************************************************************************************************************
+Create the reader of the file descriptor with a buffer of dim bytes.
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+unsigned int openReader(reader *, int, size_t);
+
+
+/**************************************************************************************************************************
+Create the reader of the lines of the string (copied).
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+unsigned int stringReader(reader *, const char *);
+
+
+/**************************************************************************************************************************
+Return the next line, valid until the next call, and its length in len (it can be NULL).
+Return NULL at the end of the input or if there is an error
+**************************************************************************************************************************/
+char *nextLine(reader *, size_t *);
+
+
+/**************************************************************************************************************************
+Free the buffer of the reader, the file descriptor isn't closed
+**************************************************************************************************************************/
+void closeReader(reader *);
+
+#endif
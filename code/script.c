@@ -0,0 +1,520 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "script.h"
+#include "parsing.h"
+#include "lexer.h"
+#include "lineedit.h"
+#include "variables.h"
+#include "trace.h"
+
+#define BLANKS " \t\n"
+#define SEPARATORS " \t\n|<>&;"	// end of the first word of a line
+
+
+/**************************************************************************************************************************
+Instructions of a compiled script:
+ - OP_RUN	execute the pipeline;
+ - OP_TEST	execute the pipeline, if its status isn't 0 jump to target;
+ - OP_JUMP	jump to target;
+ - OP_FOR	expand the words of the for loop, the loop starts again;
+ - OP_NEXT	assign the next word to the variable of the loop, at the end of the words jump to target.
+**************************************************************************************************************************/
+typedef enum {
+	OP_RUN,
+	OP_TEST,
+	OP_JUMP,
+	OP_FOR,
+	OP_NEXT
+} opcode;
+
+
+/**************************************************************************************************************************
+For loop: name of the variable, words after "in" and their values in the current execution of the loop (malloc'd)
+**************************************************************************************************************************/
+typedef struct {
+	char *name;
+	char **words;
+	int n_words;
+	char **values;
+	int n_values;
+	int next;
+} forLoop;
+
+typedef struct {
+	opcode op;
+	int target;		// index of the instruction, for OP_TEST, OP_JUMP and OP_NEXT
+	pipeline *pl;		// OP_RUN and OP_TEST, built without expansion
+	forLoop *loop;		// OP_FOR and OP_NEXT
+} instruction;
+
+
+/**************************************************************************************************************************
+State of the compiler: tokens of the current line, reader of the next lines, number of for, while and if still open
+and the instructions (malloc'd, the pipelines are in lineArena)
+**************************************************************************************************************************/
+typedef struct {
+	queue *q;
+	reader *in;
+	unsigned int depth;
+	instruction *code;
+	int n, dim;
+} compiler;
+
+static const char *keywords[] = { "for", "do", "done", "while", "if", "then", "elif", "else", "fi", NULL };
+
+
+/**************************************************************************************************************************
+Check if the word is in the list (ending with NULL).
+Return 1 if it is, else 0
+**************************************************************************************************************************/
+static unsigned int inList(const char *word, const char **list)
+{
+	for (; *list != NULL; list++)
+		if (strcmp(word, *list) == 0)
+			return 1;
+	return 0;
+}
+
+
+/**************************************************************************************************************************
+Check if the line needs the compiler of the scripts: it has ";" or it starts with a keyword (for, while, if, ...)
+Return 1 if it does, else 0
+**************************************************************************************************************************/
+unsigned int scriptLine(const char *line)
+{
+	size_t len;
+	if (strchr(line, ';') != NULL)
+		return 1;
+	line += strspn(line, BLANKS);
+	len = strcspn(line, SEPARATORS);
+	for (const char **k = keywords; *k != NULL; k++)
+		if (strlen(*k) == len && strncmp(line, *k, len) == 0)
+			return 1;
+	return 0;
+}
+
+
+/**************************************************************************************************************************
+Print the syntax error near the next token
+**************************************************************************************************************************/
+static void syntaxError(const compiler * c)
+{
+	fprintf(stdout, RED "micro-bash: syntax error near `%s'" RESET_COLOR "\n",
+		isEmpty(c->q) ? "end of line" : peek(c->q, 0).text);
+}
+
+
+/**************************************************************************************************************************
+Read the next lines until the queue has tokens, only inside a for, while or if. The end of each line is a ";".
+Return 0 if there are no more tokens (with error inside a for, while or if), else 1
+**************************************************************************************************************************/
+static unsigned int fill(compiler * c)
+{
+	char *line, *copy;
+	unsigned int num_pipe;
+	size_t len;
+	while (isEmpty(c->q)) {
+		if (c->depth == 0)	// end of the commands of the line
+			return 0;
+		if (interactive) {
+			fputs("> ", stdout);
+			line = readLine("> ");
+		} else
+			line = nextLine(c->in, NULL);
+		if (line == NULL) {
+			fprintf(stdout, RED "micro-bash: syntax error: unexpected end of file" RESET_COLOR "\n");
+			return 0;
+		}
+		if (line[strspn(line, BLANKS)] == '#')	// comment
+			continue;
+		len = strlen(line);	// the tokens stay inside the copy while the next lines are read
+		copy = (char *)arenaAlloc(&lineArena, len + 1);
+		memcpy(copy, line, len + 1);
+		if (!lexer(copy, c->q, &num_pipe) || !enqueue(c->q, (token) { SEMICOLON, ";" }))
+			return 0;
+	}
+	return 1;
+}
+
+
+/**************************************************************************************************************************
+Check if the next token is the keyword (more lines are read if needed).
+Return 1 if it is, else 0
+**************************************************************************************************************************/
+static unsigned int isKeyword(compiler * c, const char *word)
+{
+	return fill(c) && peek(c->q, 0).type == WORD && strcmp(peek(c->q, 0).text, word) == 0;
+}
+
+
+/**************************************************************************************************************************
+Skip the ";" and the ends of the lines
+**************************************************************************************************************************/
+static void skipSeparators(compiler * c)
+{
+	while (fill(c) && peek(c->q, 0).type == SEMICOLON)
+		dequeue(c->q);
+}
+
+
+/**************************************************************************************************************************
+Take the keyword after the separators.
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+static unsigned int expect(compiler * c, const char *word)
+{
+	skipSeparators(c);
+	if (!isKeyword(c, word)) {
+		syntaxError(c);
+		return 0;
+	}
+	dequeue(c->q);
+	return 1;
+}
+
+
+/**************************************************************************************************************************
+Add an instruction at the end of the code.
+Return -1 if there is an error, else its index
+**************************************************************************************************************************/
+static int emit(compiler * c, opcode op, int target, pipeline * pl, forLoop * loop)
+{
+	if (c->n == c->dim) {
+		instruction *code;
+		int dim = c->dim == 0 ? 16 : 2 * c->dim;
+		if ((code = realloc(c->code, sizeof(instruction) * dim)) == NULL)
+			return -1;
+		c->code = code;
+		c->dim = dim;
+	}
+	c->code[c->n] = (instruction) { op, target, pl, loop };
+	return c->n++;
+}
+
+
+/**************************************************************************************************************************
+Build the pipeline with the tokens until ";" or the end of the line, the variables aren't expanded.
+Return NULL if there is an error, else the pipeline
+**************************************************************************************************************************/
+static pipeline *compilePipeline(compiler * c)
+{
+	queue sub;
+	unsigned int num_pipe = 0, background = 0, ok;
+	size_t len = 0;
+	pipeline *pl;
+	token t;
+	if (!fill(c) || peek(c->q, 0).type == SEMICOLON) {
+		syntaxError(c);
+		return NULL;
+	}
+	create(&sub, QUEUEINLINE);
+	while (!isEmpty(c->q) && peek(c->q, 0).type != SEMICOLON && !background) {	// "&" ends the command too
+		t = dequeue(c->q);
+		num_pipe += t.type == PIPE;
+		background |= t.type == BACKGROUND;
+		len += strlen(t.text) + 1;
+		if (!enqueue(&sub, t)) {
+			reset(&sub);
+			return NULL;
+		}
+	}
+	pl = (pipeline *)arenaAlloc(&lineArena, sizeof(pipeline));
+	pl->line = NULL;
+	if (background) {	// the line of the job
+		queueCursor cur;
+		char *s = pl->line = (char *)arenaAlloc(&lineArena, len);
+		cursorInit(&cur, &sub);
+		while (cursorNext(&cur, &t)) {
+			s = stpcpy(s, t.text);
+			*s++ = ' ';
+		}
+		s[-1] = '\0';
+	}
+	ok = buildPipeline(&sub, num_pipe, pl, c->in, 0);	// no memfds without expansion
+	reset(&sub);
+	return ok ? pl : NULL;
+}
+
+
+static unsigned int compileList(compiler *, const char **);
+
+
+/**************************************************************************************************************************
+Compile "for name in words...; do commands; done".
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+static unsigned int compileFor(compiler * c)
+{
+	static const char *stops[] = { "done", NULL };
+	forLoop *loop = (forLoop *)arenaAlloc(&lineArena, sizeof(forLoop));
+	int n = 0, top;
+	token t;
+	if (!fill(c) || (t = peek(c->q, 0)).type != WORD || nameLength(t.text) != strlen(t.text)) {
+		syntaxError(c);
+		return 0;
+	}
+	loop->name = dequeue(c->q).text;
+	if (!expect(c, "in"))
+		return 0;
+	while (n < (int)size(c->q) && peek(c->q, n).type == WORD)	// the words until the end of the line or ";"
+		n++;
+	if (n < (int)size(c->q) && peek(c->q, n).type != SEMICOLON) {
+		fprintf(stdout, RED "micro-bash: syntax error near `%s'" RESET_COLOR "\n", peek(c->q, n).text);
+		return 0;
+	}
+	loop->words = (char **)arenaAlloc(&lineArena, sizeof(char *) * (n + 1));
+	for (loop->n_words = 0; loop->n_words < n; loop->n_words++)
+		loop->words[loop->n_words] = dequeue(c->q).text;
+	loop->values = NULL;
+	loop->n_values = loop->next = 0;
+	if (emit(c, OP_FOR, 0, NULL, loop) == -1 || (top = emit(c, OP_NEXT, 0, NULL, loop)) == -1)
+		return 0;
+	if (!expect(c, "do") || !compileList(c, stops) || !expect(c, "done"))
+		return 0;
+	if (emit(c, OP_JUMP, top, NULL, NULL) == -1)
+		return 0;
+	c->code[top].target = c->n;	// after the loop
+	return 1;
+}
+
+
+/**************************************************************************************************************************
+Compile "while pipeline; do commands; done".
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+static unsigned int compileWhile(compiler * c)
+{
+	static const char *stops[] = { "done", NULL };
+	int top = c->n, test;
+	pipeline *pl;
+	if ((pl = compilePipeline(c)) == NULL || (test = emit(c, OP_TEST, 0, pl, NULL)) == -1)
+		return 0;
+	if (!expect(c, "do") || !compileList(c, stops) || !expect(c, "done"))
+		return 0;
+	if (emit(c, OP_JUMP, top, NULL, NULL) == -1)
+		return 0;
+	c->code[test].target = c->n;
+	return 1;
+}
+
+
+/**************************************************************************************************************************
+Compile "if pipeline; then commands; [elif pipeline; then commands;]... [else commands;] fi". The jumps to the end of
+each branch are a chain through their targets until "fi".
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+static unsigned int compileIf(compiler * c)
+{
+	static const char *branchStops[] = { "elif", "else", "fi", NULL }, *elseStops[] = { "fi", NULL };
+	int chain = -1, test, next;
+	pipeline *pl;
+	while (1) {
+		if ((pl = compilePipeline(c)) == NULL || (test = emit(c, OP_TEST, 0, pl, NULL)) == -1)
+			return 0;
+		if (!expect(c, "then") || !compileList(c, branchStops))
+			return 0;
+		if ((chain = emit(c, OP_JUMP, chain, NULL, NULL)) == -1)
+			return 0;
+		c->code[test].target = c->n;	// next branch
+		if (!isKeyword(c, "elif"))
+			break;
+		dequeue(c->q);
+	}
+	if (isKeyword(c, "else")) {
+		dequeue(c->q);
+		if (!compileList(c, elseStops))
+			return 0;
+	}
+	if (!expect(c, "fi"))
+		return 0;
+	for (; chain != -1; chain = next) {
+		next = c->code[chain].target;
+		c->code[chain].target = c->n;
+	}
+	return 1;
+}
+
+
+/**************************************************************************************************************************
+Compile a for, a while, an if or a pipeline.
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+static unsigned int compileCommand(compiler * c)
+{
+	token t = peek(c->q, 0);
+	unsigned int ok;
+	if (t.type != WORD || !inList(t.text, keywords)) {
+		pipeline *pl = compilePipeline(c);
+		return pl != NULL && emit(c, OP_RUN, 0, pl, NULL) != -1;
+	}
+	dequeue(c->q);
+	c->depth++;	// the next lines are part of the command
+	if (strcmp(t.text, "for") == 0)
+		ok = compileFor(c);
+	else if (strcmp(t.text, "while") == 0)
+		ok = compileWhile(c);
+	else if (strcmp(t.text, "if") == 0)
+		ok = compileIf(c);
+	else {
+		fprintf(stdout, RED "micro-bash: syntax error near `%s'" RESET_COLOR "\n", t.text);
+		ok = 0;
+	}
+	c->depth--;
+	if (ok && !isEmpty(c->q) && peek(c->q, 0).type != SEMICOLON) {	// "done" and "fi" end the command
+		syntaxError(c);
+		ok = 0;
+	}
+	return ok;
+}
+
+
+/**************************************************************************************************************************
+Compile the commands until one of the keywords in stops (not taken) or the end of the line outside for, while and if.
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+static unsigned int compileList(compiler * c, const char **stops)
+{
+	token t;
+	while (1) {
+		skipSeparators(c);
+		if (isEmpty(c->q))	// end of the line, error if a for, while or if is open
+			return c->depth == 0;
+		t = peek(c->q, 0);
+		if (t.type == WORD && stops != NULL && inList(t.text, stops))
+			return 1;
+		if (!compileCommand(c))
+			return 0;
+	}
+}
+
+
+/**************************************************************************************************************************
+Expand the words of the for loop in a new malloc'd list, empty words made by the expansion are skipped.
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+static unsigned int startLoop(forLoop * loop)
+{
+	arenaMark mark = arenaSave(&lineArena);
+	char **words = (char **)arenaAlloc(&lineArena, sizeof(char *) * (loop->n_words + 1)), *s;
+	size_t len = 0;
+	int n = 0;
+	for (int i = 0; i < loop->n_words; i++)
+		if ((words[n] = expandWord(loop->words[i])) == loop->words[i] || words[n][0] != '\0')
+			len += strlen(words[n++]) + 1;
+	free(loop->values);
+	loop->n_values = loop->next = 0;
+	if ((loop->values = malloc(sizeof(char *) * n + len + 1)) == NULL) {
+		arenaRestore(&lineArena, mark);
+		return 0;
+	}
+	s = (char *)(loop->values + n);
+	for (int i = 0; i < n; i++) {
+		loop->values[i] = s;
+		s = stpcpy(s, words[i]) + 1;
+	}
+	loop->n_values = n;
+	arenaRestore(&lineArena, mark);
+	return 1;
+}
+
+
+/**************************************************************************************************************************
+Expand and execute a pipeline of the script, its memory in the arena is released at the end.
+Return 0 if there is an error, else 1 (the status is in lastStatus)
+**************************************************************************************************************************/
+static unsigned int runStatement(const pipeline * raw)
+{
+	arenaMark mark = arenaSave(&lineArena);
+	unsigned int ok = 0;
+	pipeline pl;
+	lastStatus = 0;
+	if (expandPipeline(raw, &pl)) {
+		ok = execCommand(&pl);
+		closeDocuments(&pl);
+	}
+	if (!ok && lastStatus == 0)
+		lastStatus = EXIT_FAILURE;
+	arenaRestore(&lineArena, mark);
+	return ok;
+}
+
+
+/**************************************************************************************************************************
+Execute the instructions. The status of an if or a while ended by its condition is 0.
+Return 0 if the last command had an error, else 1
+**************************************************************************************************************************/
+static unsigned int runProgram(const compiler * c)
+{
+	unsigned int ok = 1, testFailed = 0, executed = 0;
+	instruction *ins;
+	int pc = 0;
+	while (pc < c->n) {
+		ins = &c->code[pc++];
+		switch (ins->op) {
+		case OP_RUN:
+		case OP_TEST:
+			if (executed++ > 0)	// $? is the status of the previous command
+				prevStatus = lastStatus;
+			ok = runStatement(ins->pl);
+			testFailed = ins->op == OP_TEST && lastStatus != 0;
+			if (testFailed)
+				pc = ins->target;
+			break;
+		case OP_JUMP:
+			pc = ins->target;
+			break;
+		case OP_FOR:
+			if (!startLoop(ins->loop))
+				return 0;
+			break;
+		case OP_NEXT:
+			if (ins->loop->next == ins->loop->n_values)
+				pc = ins->target;
+			else if (!setVar(ins->loop->name, ins->loop->values[ins->loop->next++], 0))
+				return 0;
+			break;
+		}
+	}
+	if (testFailed) {
+		lastStatus = 0;
+		ok = 1;
+	}
+	return ok;
+}
+
+
+/**************************************************************************************************************************
+Free the instructions and the values of the loops
+**************************************************************************************************************************/
+static void freeProgram(compiler * c)
+{
+	for (int i = 0; i < c->n; i++)
+		if (c->code[i].op == OP_FOR)
+			free(c->code[i].loop->values);
+	free(c->code);
+}
+
+
+/**************************************************************************************************************************
+Compile the commands in the queue (tokens of one line, more lines are read from the reader until the end of the open
+for, while and if) to a list of instructions, then execute it: the commands are lexed, checked and built only once,
+their variables are expanded before each execution.
+Return 0 if there is an error, else 1 (the status of the last command is in lastStatus)
+**************************************************************************************************************************/
+unsigned int runScript(queue * q, reader * in)
+{
+	compiler c = { q, in, 0, NULL, 0, 0 };
+	unsigned int ok;
+	TRACE_START(start);
+	if (!enqueue(q, (token) { SEMICOLON, ";" }))	// end of the first line
+		return 0;
+	ok = compileList(&c, NULL);
+	TRACE_SPAN(start, "compile", NULL);
+	if (ok && !noExec)
+		ok = runProgram(&c);
+	freeProgram(&c);
+	return ok;
+}
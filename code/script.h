@@ -0,0 +1,27 @@
+#ifndef SCRIPT_H
+#define SCRIPT_H
+
+#include "queue.h"
+#include "reader.h"
+
+
+/**************************************************************************************************************************
+Check if the line needs the compiler of the scripts: it has ";" or it starts with a keyword (for, while, if, ...)
+Return 1 if it does, else 0
+**************************************************************************************************************************/
+unsigned int scriptLine(const char *);
+
+
+/**************************************************************************************************************************
+Compile the commands in the queue (tokens of one line, more lines are read from the reader until the end of the open
+for, while and if) to a list of instructions, then execute it: the commands are lexed, checked and built only once,
+their variables are expanded before each execution.
+ - for name in words...; do commands; done
+ - while pipeline; do commands; done
+ - if pipeline; then commands; [elif pipeline; then commands;]... [else commands;] fi
+ - commands separated by ";" or by the end of the line.
+Return 0 if there is an error, else 1 (the status of the last command is in lastStatus)
+**************************************************************************************************************************/
+unsigned int runScript(queue *, reader *);
+
+#endif
@@ -0,0 +1,281 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "server.h"
+#include "jobs.h"
+
+
+/**************************************************************************************************************************
+Fill the address of the Unix socket path.
+Return 0 if the path is too long, else 1
+**************************************************************************************************************************/
+static unsigned int socketAddress(struct sockaddr_un *addr, const char *path)
+{
+	if (strlen(path) >= sizeof(addr->sun_path)) {
+		fprintf(stderr, "micro-bash: %s: path of the socket too long\n", path);
+		return 0;
+	}
+	memset(addr, 0, sizeof(*addr));
+	addr->sun_family = AF_UNIX;
+	strcpy(addr->sun_path, path);
+	return 1;
+}
+
+
+/**************************************************************************************************************************
+Read len bytes from the socket.
+Return 0 if there is an error or the connection is closed before, else 1
+**************************************************************************************************************************/
+static unsigned int readAll(int fd, void *buf, size_t len)
+{
+	ssize_t n;
+	for (size_t done = 0; done < len;)
+		if ((n = recv(fd, (char *)buf + done, len - done, 0)) > 0)
+			done += n;
+		else if (n == 0 || errno != EINTR)
+			return 0;
+	return 1;
+}
+
+
+/**************************************************************************************************************************
+Write len bytes on the socket (no SIGPIPE if the other side has closed).
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+static unsigned int writeAll(int fd, const void *buf, size_t len)
+{
+	ssize_t n;
+	for (size_t done = 0; done < len;)
+		if ((n = send(fd, (const char *)buf + done, len - done, MSG_NOSIGNAL)) >= 0)
+			done += n;
+		else if (errno != EINTR)
+			return 0;
+	return 1;
+}
+
+
+/**************************************************************************************************************************
+Read the request of the client: the stdio of the client becomes 0, 1, 2 of the process and the commands are put in the
+reader.
+Return 0 if the request is wrong, else 1
+**************************************************************************************************************************/
+static unsigned int readRequest(int conn, reader * in)
+{
+	uint32_t len;
+	int fds[3];
+	char control[CMSG_SPACE(sizeof(fds))], *commands;
+	struct iovec iov = { &len, sizeof(len) };
+	struct msghdr msg;
+	struct cmsghdr *cm;
+	unsigned int ok;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+	if (recvmsg(conn, &msg, MSG_WAITALL | MSG_CMSG_CLOEXEC) != sizeof(len))
+		return 0;
+	if ((cm = CMSG_FIRSTHDR(&msg)) == NULL || cm->cmsg_level != SOL_SOCKET || cm->cmsg_type != SCM_RIGHTS)
+		return 0;
+	if (cm->cmsg_len != CMSG_LEN(sizeof(fds)) || (msg.msg_flags & MSG_CTRUNC)) {	// not the 3 stdio
+		for (int i = 0; i < (int)((cm->cmsg_len - CMSG_LEN(0)) / sizeof(int)); i++)
+			close(((int *)CMSG_DATA(cm))[i]);
+		return 0;
+	}
+	memcpy(fds, CMSG_DATA(cm), sizeof(fds));
+	for (int i = 0; i < 3; i++)	// above 2 before the dup2, if the server runs without stdio
+		if (fds[i] < 3)
+			fds[i] = fcntl(fds[i], F_DUPFD_CLOEXEC, 3);
+	for (int i = 0; i < 3; i++) {
+		dup2(fds[i], i);
+		close(fds[i]);
+	}
+	if (len > MAXREQUEST) {
+		fprintf(stderr, "micro-bash: request of %u bytes, the max is %d\n", len, MAXREQUEST);
+		return 0;
+	}
+	if ((commands = malloc(len + 1)) == NULL)
+		return 0;
+	if ((ok = readAll(conn, commands, len))) {
+		commands[len] = '\0';
+		ok = stringReader(in, commands);
+	}
+	free(commands);
+	return ok;
+}
+
+
+/**************************************************************************************************************************
+Child ready for a client: wait for a connection, tell the server (one byte on the pipe) that a new child is needed,
+then read the request. The child is killed if the server ends while it's waiting.
+Return the connection, -1 if there is an error
+**************************************************************************************************************************/
+static int serveOne(int lfd, int notify, reader * in, pid_t server)
+{
+	int conn;
+	prctl(PR_SET_PDEATHSIG, SIGTERM);	// a child without client ends with the server
+	if (getppid() != server)
+		_exit(0);
+	while ((conn = accept4(lfd, NULL, NULL, SOCK_CLOEXEC)) == -1)
+		if (errno != EINTR && errno != ECONNABORTED) {
+			fprintf(stderr, "micro-bash: accept: %s\n", strerror(errno));
+			break;
+		}
+	prctl(PR_SET_PDEATHSIG, 0);	// the commands of the client end also without the server
+	write(notify, "", 1);	// also if accept failed, for a new child
+	close(notify);
+	close(lfd);
+	if (conn == -1)
+		return -1;
+	initJobs();	// the commands of the client are reaped as in the shell
+	if (!readRequest(conn, in)) {
+		close(conn);
+		return -1;
+	}
+	return conn;
+}
+
+
+/**************************************************************************************************************************
+Listen on the Unix socket path (a socket left by a killed server is removed) and serve the clients concurrently: each
+connection is served by a child of the server, that inherits the environment and the variables of the shell (the
+PATH and plan caches start empty, the server never runs a command). SERVERSPARE children are always waiting for a
+client, so the fork isn't in the time of the request: when a child takes a client the server makes a new one. The
+server never returns if there is no error.
+Return the connection in the child, with the stdio of the client on 0, 1, 2 and the commands in the reader, -1 if
+there is an error (in the server or in the request)
+**************************************************************************************************************************/
+int serveClients(const char *path, reader * in)
+{
+	struct sockaddr_un addr;
+	struct sigaction sa;
+	struct stat st;
+	int lfd, notify[2], spare = 0;
+	pid_t server = getpid();
+	char c;
+	ssize_t n;
+	pid_t pid;
+	if (!socketAddress(&addr, path))
+		return -1;
+	if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+		unlink(path);
+	if ((lfd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) == -1 || bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+		fprintf(stderr, "micro-bash: %s: %s\n", path, strerror(errno));
+		if (lfd != -1)
+			close(lfd);
+		return -1;
+	}
+	if (listen(lfd, SOMAXCONN) == -1 || pipe2(notify, O_CLOEXEC) == -1) {
+		fprintf(stderr, "micro-bash: %s: %s\n", path, strerror(errno));
+		close(lfd);
+		unlink(path);
+		return -1;
+	}
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = SIG_DFL;
+	sa.sa_flags = SA_NOCLDWAIT;	// the children that served a client are reaped by the kernel
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGCHLD, &sa, NULL);
+	fflush(stdout);	// nothing buffered is written again by the children
+	while (1) {
+		while (spare < SERVERSPARE) {
+			if ((pid = fork()) == 0) {
+				close(notify[0]);
+				return serveOne(lfd, notify[1], in, server);
+			}
+			if (pid == -1) {
+				fprintf(stderr, "micro-bash: fork: %s\n", strerror(errno));
+				if (spare == 0) {	// nobody would accept the clients
+					sleep(1);
+					continue;
+				}
+				break;
+			}
+			spare++;
+		}
+		if ((n = read(notify[0], &c, 1)) == 1)	// a child took a client
+			spare--;
+		else if (n == 0 || errno != EINTR)
+			break;
+	}
+	close(notify[0]);
+	close(notify[1]);
+	close(lfd);
+	unlink(path);
+	return -1;
+}
+
+
+/**************************************************************************************************************************
+Send the exit status of the commands to the client and close the connection
+**************************************************************************************************************************/
+void sendStatus(int conn, int status)
+{
+	int32_t s = status;
+	fflush(stdout);	// the output arrives before the status
+	writeAll(conn, &s, sizeof(s));
+	close(conn);
+}
+
+
+/**************************************************************************************************************************
+Send the commands with stdin, stdout and stderr to the server listening on the Unix socket path, and wait for the end.
+Return the exit status of the last command, 2 if there is an error
+**************************************************************************************************************************/
+int runClient(const char *path, const char *commands)
+{
+	struct sockaddr_un addr;
+	size_t len = strlen(commands);
+	uint32_t hdr = len;
+	int32_t status;
+	int fds[3] = { STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO }, sock;
+	char control[CMSG_SPACE(sizeof(fds))];
+	struct iovec iov = { &hdr, sizeof(hdr) };
+	struct msghdr msg;
+	struct cmsghdr *cm;
+	if (!socketAddress(&addr, path))
+		return 2;
+	if (len > MAXREQUEST) {
+		fprintf(stderr, "micro-bash: request of %zu bytes, the max is %d\n", len, MAXREQUEST);
+		return 2;
+	}
+	if ((sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) == -1 || connect(sock, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+		fprintf(stderr, "micro-bash: %s: %s\n", path, strerror(errno));
+		if (sock != -1)
+			close(sock);
+		return 2;
+	}
+	memset(&msg, 0, sizeof(msg));
+	memset(control, 0, sizeof(control));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+	cm = CMSG_FIRSTHDR(&msg);
+	cm->cmsg_level = SOL_SOCKET;
+	cm->cmsg_type = SCM_RIGHTS;
+	cm->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(cm), fds, sizeof(fds));
+	if (sendmsg(sock, &msg, MSG_NOSIGNAL) != sizeof(hdr) || !writeAll(sock, commands, len)) {
+		fprintf(stderr, "micro-bash: %s: %s\n", path, strerror(errno));
+		close(sock);
+		return 2;
+	}
+	if (!readAll(sock, &status, sizeof(status))) {
+		fprintf(stderr, "micro-bash: %s: the server closed the connection\n", path);
+		status = 2;
+	}
+	close(sock);
+	return status;
+}
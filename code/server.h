@@ -0,0 +1,42 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "reader.h"
+
+#define MAXREQUEST 1048576	// max length of the commands of a request
+#define SERVERSPARE 2	// children of the server waiting for a client
+
+
+/**************************************************************************************************************************
+Protocol of the server, on a Unix stream socket:
+ - the client sends the length of the commands (uint32_t, native byte order) with its stdin, stdout and stderr as
+   SCM_RIGHTS, then the commands (one or more lines);
+ - the server replies with the exit status of the last command (int32_t) after all the commands have ended.
+**************************************************************************************************************************/
+
+
+/**************************************************************************************************************************
+Listen on the Unix socket path (a socket left by a killed server is removed) and serve the clients concurrently: each
+connection is served by a child of the server, that inherits the environment and the variables of the shell (the
+PATH and plan caches start empty, the server never runs a command). SERVERSPARE children are always waiting for a
+client, so the fork isn't in the time of the request: when a child takes a client the server makes a new one. The
+server never returns if there is no error.
+Return the connection in the child, with the stdio of the client on 0, 1, 2 and the commands in the reader, -1 if
+there is an error (in the server or in the request)
+**************************************************************************************************************************/
+int serveClients(const char *, reader *);
+
+
+/**************************************************************************************************************************
+Send the exit status of the commands to the client and close the connection
+**************************************************************************************************************************/
+void sendStatus(int, int);
+
+
+/**************************************************************************************************************************
+Send the commands with stdin, stdout and stderr to the server listening on the Unix socket path, and wait for the end.
+Return the exit status of the last command, 2 if there is an error
+**************************************************************************************************************************/
+int runClient(const char *, const char *);
+
+#endif
@@ -0,0 +1,83 @@
+#define _GNU_SOURCE
+
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "session.h"
+#include "parsing.h"
+#include "variables.h"
+
+extern char **environ;
+
+session shell = { .path = DEFAULTPATH };
+
+
+/**************************************************************************************************************************
+Render the prompt with the current directory.
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+static unsigned int renderPrompt()
+{
+	char *prompt;
+	if (asprintf(&prompt, GREEN "%s" RESET_COLOR "$ ", shell.cwd != NULL ? shell.cwd : "?") == -1)
+		return 0;
+	free(shell.prompt);
+	shell.prompt = prompt;
+	return 1;
+}
+
+
+/**************************************************************************************************************************
+Read the current directory and the variables of the environment, render the prompt.
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+unsigned int sessionInit()
+{
+	shell.cwd = getcwd(NULL, 0);	// NULL if the directory was removed
+	initVariables(environ);
+	return renderPrompt();
+}
+
+
+/**************************************************************************************************************************
+Free the memory of the session and the variables
+**************************************************************************************************************************/
+void sessionFree()
+{
+	freeVariables();
+	free(shell.cwd);
+	free(shell.prompt);
+	shell.cwd = shell.prompt = NULL;
+}
+
+
+/**************************************************************************************************************************
+Set and export the variable (name, value).
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+unsigned int sessionSetenv(const char *name, const char *value)
+{
+	return setVar(name, value, VAR_EXPORT);
+}
+
+
+/**************************************************************************************************************************
+Change the current directory, update cwd, PWD, OLDPWD and the prompt.
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+unsigned int sessionChdir(const char *dir)
+{
+	char *cwd;
+	if (chdir(dir) == -1)
+		return 0;
+	if ((cwd = getcwd(NULL, 0)) == NULL)
+		return 0;
+	if (shell.cwd != NULL)
+		sessionSetenv("OLDPWD", shell.cwd);
+	sessionSetenv("PWD", cwd);
+	free(shell.cwd);
+	shell.cwd = cwd;
+	shell.cwdGen++;
+	return renderPrompt();
+}
@@ -0,0 +1,52 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#define DEFAULTPATH "/usr/local/bin:/usr/bin:/bin"	// PATH used when it is unset
+
+/**************************************************************************************************************************
+State of the shell kept between the command lines, so a line doesn't pay syscalls to rebuild it:
+ - cwd: current directory, changed only by cd, and cwdGen, incremented when it changes;
+ - prompt: the prompt already rendered with the colors;
+ - envp: environment passed to the commands, rebuilt only after a change of an exported variable (NULL until then);
+ - path: value of PATH (default one if unset) and pathGen, incremented when PATH changes or hash -r empties the
+   table of the commands.
+**************************************************************************************************************************/
+typedef struct {
+	char *cwd;
+	char *prompt;
+	char **envp;
+	const char *path;
+	unsigned int pathGen;
+	unsigned int cwdGen;
+} session;
+
+extern session shell;
+
+
+/**************************************************************************************************************************
+Read the current directory and the variables of the environment, render the prompt.
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+unsigned int sessionInit();
+
+
+/**************************************************************************************************************************
+Free the memory of the session and the variables
+**************************************************************************************************************************/
+void sessionFree();
+
+
+/**************************************************************************************************************************
+Change the current directory, update cwd, PWD, OLDPWD and the prompt.
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+unsigned int sessionChdir(const char *);
+
+
+/**************************************************************************************************************************
+Set and export the variable (name, value).
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+unsigned int sessionSetenv(const char *, const char *);
+
+#endif
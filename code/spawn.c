@@ -0,0 +1,490 @@
+#define _GNU_SOURCE
+
+#include <unistd.h>
+#include <string.h>
+#include <spawn.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include "spawn.h"
+#include "parsing.h"
+#include "session.h"
+#include "cpusched.h"
+
+#define CLONESTACK 65536	// stack of a clone (command of the zygote or with a scheduling) until execve
+
+
+/**************************************************************************************************************************
+Request to the zygote, followed by size bytes of strings ended by '\0': path, current directory, argc arguments and envc
+variables. stdin, stdout and stderr of the command are sent with the header as SCM_RIGHTS, the scheduling is in the
+header.
+**************************************************************************************************************************/
+typedef struct {
+	uint32_t size;
+	uint32_t argc;
+	uint32_t envc;
+	stageSched sched;	// scheduling of the command, set is 0 if it doesn't change
+} zygoteRequest;
+
+
+/**************************************************************************************************************************
+Reply of the zygote: pid of the command (-1 if it wasn't created) and errno of chdir, clone or execve (0 if it started)
+**************************************************************************************************************************/
+typedef struct {
+	int32_t pid;
+	int32_t err;
+} zygoteReply;
+
+
+/**************************************************************************************************************************
+Command started with clone(CLONE_VM | CLONE_VFORK), in the memory of its father until execve: err is written by the
+clone if execve fails
+**************************************************************************************************************************/
+typedef struct {
+	int fds[3];		// stdin, stdout and stderr of the command, -1 or less to inherit them
+	const int *fds_close;
+	int n_close;
+	const char *path;
+	char **argv;
+	char **envp;
+	const stageSched *sched;	// NULL if the scheduling doesn't change
+	int err;
+} cloneExec;
+
+unsigned int spawnBackend = SPAWN_POSIX;
+static int zygoteSock = -1;
+static pid_t zygotePid = 0, zygoteOwner = 0;	// the shell that started the zygote, the only one that can use it
+static char *requestBuf = NULL, *stack = NULL;
+static size_t requestDim = 0;
+
+
+/**************************************************************************************************************************
+Choose the backend by name ("posix_spawn", "fork" or "zygote"), NULL keeps the default.
+Return 0 if the name is unknown, else 1
+**************************************************************************************************************************/
+unsigned int setSpawnBackend(const char *name)
+{
+	if (name == NULL)
+		return 1;
+	if (strcmp(name, "posix_spawn") == 0)
+		spawnBackend = SPAWN_POSIX;
+	else if (strcmp(name, "fork") == 0)
+		spawnBackend = SPAWN_FORK;
+	else if (strcmp(name, "zygote") == 0)
+		spawnBackend = SPAWN_ZYGOTE;
+	else
+		return 0;
+	return 1;
+}
+
+
+/**************************************************************************************************************************
+Give back to a child the signal mask of the shell: SIGPIPE is unblocked, the shell blocks it around the build in
+commands (parallel spawns while it runs).
+**************************************************************************************************************************/
+void childSigmask()
+{
+	sigset_t pipeSet;
+	sigemptyset(&pipeSet);
+	sigaddset(&pipeSet, SIGPIPE);
+	sigprocmask(SIG_UNBLOCK, &pipeSet, NULL);
+}
+
+
+/**************************************************************************************************************************
+Child started with clone(CLONE_VM | CLONE_VFORK): it changes its scheduling, redirects stdin, stdout and stderr, closes
+the descriptors and calls execve. The father is suspended until execve, the errno of a failure is left in the request.
+**************************************************************************************************************************/
+static int cloneChild(void *arg)
+{
+	cloneExec *e = arg;
+	childSigmask();
+	applySched(e->sched);
+	for (int i = 0; i < 3; i++)	// above 2, so the dup2 don't overwrite them
+		if (e->fds[i] >= 0 && e->fds[i] < 3 && (e->fds[i] = fcntl(e->fds[i], F_DUPFD_CLOEXEC, 3)) == -1)
+			goto error;
+	for (int i = 0; i < 3; i++)
+		if (e->fds[i] >= 0 && dup2(e->fds[i], i) == -1)	// the copy doesn't have FD_CLOEXEC
+			goto error;
+	for (int i = 0; i < e->n_close; i++)
+		if (e->fds_close[i] > STDERR_FILENO)
+			close(e->fds_close[i]);
+	execve(e->path, e->argv, e->envp);
+error:
+	e->err = errno;
+	_exit(127);
+}
+
+
+/**************************************************************************************************************************
+Start the command of e with clone, like posix_spawn: the memory isn't copied and the father waits for execve. flags
+are added to CLONE_VM | CLONE_VFORK.
+Return -1 if clone fails, else the pid of the child (e->err is not 0 if execve failed)
+**************************************************************************************************************************/
+static pid_t startClone(cloneExec * e, int flags)
+{
+	if (stack == NULL && (stack = malloc(CLONESTACK)) == NULL)	// one clone at a time, the same stack for all
+		return -1;
+	e->err = 0;
+	return clone(cloneChild, stack + CLONESTACK, CLONE_VM | CLONE_VFORK | SIGCHLD | flags, e);
+}
+
+
+/**************************************************************************************************************************
+Spawn with clone, for a command that changes its scheduling before execve (posix_spawn can't).
+Return -1 if there is an error, else the pid of the child
+**************************************************************************************************************************/
+static pid_t spawnClone(const char *path, char **argv, char **envp, int fd_in, int fd_out, const int *fds_close, int n_close,
+			const stageSched * sched)
+{
+	cloneExec e = { { fd_in, fd_out, -1 }, fds_close, n_close, path, argv, envp, sched, 0 };
+	pid_t pid = startClone(&e, 0);
+	if (pid == -1 || e.err != 0) {
+		if (pid > 0)	// execve failed
+			waitpid(pid, NULL, 0);
+		fprintf(stdout, RED "*** BAD COMMAND!!! *** - Error of: %s" RESET_COLOR "\n", argv[0]);
+		return -1;
+	}
+	return pid;
+}
+
+
+/**************************************************************************************************************************
+Spawn with posix_spawn: redirections and closes are file actions executed in the child only, so the father never
+touches its own descriptors and glibc can use CLONE_VFORK instead of copying the page tables.
+Return -1 if there is an error, else the pid of the child
+**************************************************************************************************************************/
+static pid_t spawnPosix(const char *path, char **argv, char **envp, int fd_in, int fd_out, const int *fds_close, int n_close,
+		       const stageSched * sched)
+{
+	static posix_spawnattr_t attr;
+	static int attrReady = 0;
+	posix_spawn_file_actions_t actions;
+	sigset_t mask;
+	pid_t pid;
+	int err;
+	if (sched != NULL)	// posix_spawn can't change the affinity, nice and I/O priority
+		return spawnClone(path, argv, envp, fd_in, fd_out, fds_close, n_close, sched);
+	if (!attrReady) {	// the mask of the shell without SIGPIPE, also if a build in has blocked it
+		if (posix_spawnattr_init(&attr) != 0)
+			return -1;
+		sigprocmask(SIG_SETMASK, NULL, &mask);
+		sigdelset(&mask, SIGPIPE);
+		posix_spawnattr_setsigmask(&attr, &mask);
+		posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK);
+		attrReady = 1;
+	}
+	if (posix_spawn_file_actions_init(&actions) != 0)
+		return -1;
+	if (fd_in >= 0)
+		posix_spawn_file_actions_adddup2(&actions, fd_in, STDIN_FILENO);	// redirect input
+	if (fd_out >= 0)
+		posix_spawn_file_actions_adddup2(&actions, fd_out, STDOUT_FILENO);	// redirect output
+	for (int i = 0; i < n_close; i++)
+		if (fds_close[i] > STDERR_FILENO)
+			posix_spawn_file_actions_addclose(&actions, fds_close[i]);
+	err = posix_spawn(&pid, path, &actions, &attr, argv, envp);
+	posix_spawn_file_actions_destroy(&actions);
+	if (err != 0) {	// exec failed, the child is already reaped
+		fprintf(stdout, RED "*** BAD COMMAND!!! *** - Error of: %s" RESET_COLOR "\n", argv[0]);
+		return -1;
+	}
+	return pid;
+}
+
+
+/**************************************************************************************************************************
+Spawn with fork: the child changes its scheduling, redirects its input/output, closes the descriptors and calls execve.
+Return -1 if there is an error, else the pid of the child
+**************************************************************************************************************************/
+static pid_t spawnFork(const char *path, char **argv, char **envp, int fd_in, int fd_out, const int *fds_close, int n_close,
+		      const stageSched * sched)
+{
+	pid_t pid;
+	fflush(stdout);	// nothing buffered has to be written twice
+	if ((pid = fork()) != 0)
+		return pid;	// father process or fork error
+	// child process
+	childSigmask();
+	applySched(sched);
+	if (fd_in >= 0 && dup2(fd_in, STDIN_FILENO) == -1) {	// redirect input
+		perror("Error dup2 for input redirect\n");
+		exit(EXIT_FAILURE);
+	}
+	if (fd_out >= 0 && dup2(fd_out, STDOUT_FILENO) == -1) {	// redirect output
+		perror("Error dup2 for output redirect\n");
+		exit(EXIT_FAILURE);
+	}
+	for (int i = 0; i < n_close; i++)	// close all file descriptor
+		if (fds_close[i] > STDERR_FILENO)
+			close(fds_close[i]);
+	execve(path, argv, envp);	// execute command
+	// execve failed
+	fprintf(stdout, RED "*** BAD COMMAND!!! *** - Error of: %s" RESET_COLOR "\n", argv[0]);
+	exit(EXIT_FAILURE);
+}
+
+
+/**************************************************************************************************************************
+Make the buffer at least need bytes.
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+static unsigned int reserve(char **buf, size_t *dim, size_t need)
+{
+	char *newBuf;
+	size_t newDim = *dim == 0 ? 4096 : *dim;
+	if (need <= *dim)
+		return 1;
+	while (newDim < need)
+		newDim *= 2;
+	if ((newBuf = realloc(*buf, newDim)) == NULL)
+		return 0;
+	*buf = newBuf;
+	*dim = newDim;
+	return 1;
+}
+
+
+/**************************************************************************************************************************
+Read len bytes from the socket.
+Return 0 if there is an error or the other side has closed, else 1
+**************************************************************************************************************************/
+static unsigned int recvAll(int fd, void *buf, size_t len)
+{
+	ssize_t n;
+	for (size_t done = 0; done < len;)
+		if ((n = recv(fd, (char *)buf + done, len - done, 0)) > 0)
+			done += n;
+		else if (n == 0 || errno != EINTR)
+			return 0;
+	return 1;
+}
+
+
+/**************************************************************************************************************************
+Write len bytes on the socket.
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+static unsigned int sendAll(int fd, const void *buf, size_t len)
+{
+	ssize_t n;
+	for (size_t done = 0; done < len;)
+		if ((n = send(fd, (const char *)buf + done, len - done, MSG_NOSIGNAL)) >= 0)
+			done += n;
+		else if (errno != EINTR)
+			return 0;
+	return 1;
+}
+
+
+/**************************************************************************************************************************
+Main loop of the zygote: for each request it moves to the directory of the shell and starts the command with clone
+and CLONE_PARENT (the memory is shared until execve), the pid and the result of execve go back to the shell. It ends
+when the shell closes the socket.
+**************************************************************************************************************************/
+static void zygoteLoop(int sock)
+{
+	char control[CMSG_SPACE(3 * sizeof(int))], *buf = NULL, *here = NULL, *path, *dir, *p, **vec = NULL, **argv, **envp;
+	size_t dim = 0, vecDim = 0;
+	int fds[3];
+	zygoteRequest req;
+	cloneExec e;
+	zygoteReply rep;
+	struct iovec iov = { &req, sizeof(req) };
+	struct msghdr msg;
+	struct cmsghdr *cm;
+	while (1) {
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		if (recvmsg(sock, &msg, MSG_WAITALL | MSG_CMSG_CLOEXEC) != sizeof(req))	// the shell has ended
+			_exit(0);
+		if ((cm = CMSG_FIRSTHDR(&msg)) == NULL || cm->cmsg_type != SCM_RIGHTS || cm->cmsg_len != CMSG_LEN(sizeof(fds)))
+			_exit(EXIT_FAILURE);
+		memcpy(fds, CMSG_DATA(cm), sizeof(fds));
+		if (!reserve(&buf, &dim, req.size) || !recvAll(sock, buf, req.size))
+			_exit(EXIT_FAILURE);
+		if (vecDim < (size_t)req.argc + req.envc + 2) {
+			vecDim = (size_t)req.argc + req.envc + 2;
+			if ((vec = realloc(vec, vecDim * sizeof(char *))) == NULL)
+				_exit(EXIT_FAILURE);
+		}
+		path = buf;
+		dir = path + strlen(path) + 1;
+		p = dir + strlen(dir) + 1;
+		argv = vec;
+		envp = vec + req.argc + 1;
+		for (uint32_t i = 0; i < req.argc; i++, p += strlen(p) + 1)
+			argv[i] = p;
+		argv[req.argc] = NULL;
+		for (uint32_t i = 0; i < req.envc; i++, p += strlen(p) + 1)
+			envp[i] = p;
+		envp[req.envc] = NULL;
+		rep.pid = -1;
+		rep.err = 0;
+		if (dir[0] != '\0' && (here == NULL || strcmp(dir, here) != 0)) {	// the shell has changed directory
+			free(here);
+			here = chdir(dir) == 0 ? strdup(dir) : NULL;
+			if (here == NULL)
+				rep.err = errno;
+		}
+		if (rep.err == 0) {	// like posix_spawn: the memory isn't copied and the zygote waits for execve
+			e = (cloneExec) { { fds[0], fds[1], fds[2] }, NULL, 0, path, argv, envp, req.sched.set != 0 ? &req.sched : NULL, 0 };
+			rep.pid = startClone(&e, CLONE_PARENT);
+			rep.err = rep.pid == -1 ? errno : e.err;
+		}
+		for (int i = 0; i < 3; i++)
+			close(fds[i]);
+		if (!sendAll(sock, &rep, sizeof(rep)))
+			_exit(0);
+	}
+}
+
+
+/**************************************************************************************************************************
+Start the zygote, to call while the memory of the shell is still small: the zygote receives the commands on a
+socketpair and clones itself with CLONE_PARENT, so the commands are children of the shell (waited as usual).
+Return 0 if there is an error (posix_spawn is used), else 1
+**************************************************************************************************************************/
+unsigned int startZygote()
+{
+	int sv[2];
+	pid_t shellPid = getpid();
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) == -1) {
+		fprintf(stderr, "micro-bash: zygote: %s, using posix_spawn\n", strerror(errno));
+		spawnBackend = SPAWN_POSIX;
+		return 0;
+	}
+	fflush(stdout);	// nothing buffered is written again by the zygote
+	if ((zygotePid = fork()) == 0) {
+		close(sv[0]);
+		prctl(PR_SET_PDEATHSIG, SIGKILL);	// it ends with the shell
+		if (getppid() != shellPid)
+			_exit(0);
+		zygoteLoop(sv[1]);
+	}
+	close(sv[1]);
+	if (zygotePid == -1) {
+		fprintf(stderr, "micro-bash: zygote: %s, using posix_spawn\n", strerror(errno));
+		close(sv[0]);
+		spawnBackend = SPAWN_POSIX;
+		return 0;
+	}
+	zygoteSock = sv[0];
+	zygoteOwner = shellPid;
+	return 1;
+}
+
+
+/**************************************************************************************************************************
+Stop the zygote and wait for its end
+**************************************************************************************************************************/
+void stopZygote()
+{
+	if (zygoteSock == -1 || getpid() != zygoteOwner)
+		return;
+	close(zygoteSock);
+	waitpid(zygotePid, NULL, 0);
+	zygoteSock = -1;
+	free(requestBuf);
+	requestBuf = NULL;
+	requestDim = 0;
+}
+
+
+/**************************************************************************************************************************
+Spawn with the zygote: the strings of the command are copied in one request, sent with stdin, stdout and stderr of
+the command. The descriptors to close are not in the zygote, nothing to do for them. If the zygote doesn't answer the
+command and the next ones are launched with posix_spawn.
+Return -1 if there is an error, else the pid of the child
+**************************************************************************************************************************/
+static pid_t spawnZygote(const char *path, char **argv, char **envp, int fd_in, int fd_out, const int *fds_close, int n_close,
+			 const stageSched * sched)
+{
+	const char *cwd = shell.cwd != NULL ? shell.cwd : "";
+	int fds[3] = { fd_in >= 0 ? fd_in : STDIN_FILENO, fd_out >= 0 ? fd_out : STDOUT_FILENO, STDERR_FILENO };
+	char control[CMSG_SPACE(sizeof(fds))], *p;
+	size_t len, size = strlen(path) + strlen(cwd) + 2;
+	zygoteRequest req;
+	zygoteReply rep;
+	struct iovec iov = { &req, sizeof(req) };
+	struct msghdr msg;
+	struct cmsghdr *cm;
+	req.argc = req.envc = 0;
+	req.sched.set = 0;
+	if (sched != NULL)
+		req.sched = *sched;
+	for (; argv[req.argc] != NULL; req.argc++)
+		size += strlen(argv[req.argc]) + 1;
+	for (; envp[req.envc] != NULL; req.envc++)
+		size += strlen(envp[req.envc]) + 1;
+	if (size > UINT32_MAX || !reserve(&requestBuf, &requestDim, size)) {
+		fprintf(stdout, RED "*** BAD COMMAND!!! *** - Error of: %s" RESET_COLOR "\n", argv[0]);
+		return -1;
+	}
+	req.size = size;
+	p = requestBuf;
+	len = strlen(path) + 1;
+	p = (char *)memcpy(p, path, len) + len;
+	len = strlen(cwd) + 1;
+	p = (char *)memcpy(p, cwd, len) + len;
+	for (uint32_t i = 0; i < req.argc; i++) {
+		len = strlen(argv[i]) + 1;
+		p = (char *)memcpy(p, argv[i], len) + len;
+	}
+	for (uint32_t i = 0; i < req.envc; i++) {
+		len = strlen(envp[i]) + 1;
+		p = (char *)memcpy(p, envp[i], len) + len;
+	}
+	memset(&msg, 0, sizeof(msg));
+	memset(control, 0, sizeof(control));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+	cm = CMSG_FIRSTHDR(&msg);
+	cm->cmsg_level = SOL_SOCKET;
+	cm->cmsg_type = SCM_RIGHTS;
+	cm->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(cm), fds, sizeof(fds));
+	if (sendmsg(zygoteSock, &msg, MSG_NOSIGNAL) != sizeof(req) || !sendAll(zygoteSock, requestBuf, size)
+			|| !recvAll(zygoteSock, &rep, sizeof(rep))) {
+		fprintf(stderr, "micro-bash: zygote: not answering, using posix_spawn\n");
+		stopZygote();
+		spawnBackend = SPAWN_POSIX;
+		return spawnPosix(path, argv, envp, fd_in, fd_out, fds_close, n_close, sched);
+	}
+	if (rep.err != 0) {
+		if (rep.pid > 0)	// execve failed, the child is a child of the shell
+			waitpid(rep.pid, NULL, 0);
+		fprintf(stdout, RED "*** BAD COMMAND!!! *** - Error of: %s" RESET_COLOR "\n", argv[0]);
+		return -1;
+	}
+	return rep.pid;
+}
+
+
+/**************************************************************************************************************************
+Launch the file path (already resolved by lookupCommand) with arguments argv, environment envp, fd_in as stdin and
+fd_out as stdout (-1 or less to inherit them) and close the n_close descriptors of fds_close in the child only. The
+child applies the scheduling sched before exec (NULL to keep the one of the shell).
+Return -1 if there is an error, else the pid of the child
+**************************************************************************************************************************/
+pid_t spawnCommand(const char *path, char **argv, char **envp, int fd_in, int fd_out, const int *fds_close, int n_close,
+		   const stageSched * sched)
+{
+	if (spawnBackend == SPAWN_FORK)
+		return spawnFork(path, argv, envp, fd_in, fd_out, fds_close, n_close, sched);
+	if (spawnBackend == SPAWN_ZYGOTE && getpid() == zygoteOwner)	// not in a build in forked by the shell
+		return spawnZygote(path, argv, envp, fd_in, fd_out, fds_close, n_close, sched);
+	return spawnPosix(path, argv, envp, fd_in, fd_out, fds_close, n_close, sched);
+}
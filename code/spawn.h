@@ -0,0 +1,54 @@
+#ifndef SPAWN_H
+#define SPAWN_H
+
+#include <sys/types.h>
+#include "cpusched.h"
+
+#define SPAWN_POSIX 0	// posix_spawn with file actions (default)
+#define SPAWN_FORK 1	// classic fork + dup2 + execvp
+#define SPAWN_ZYGOTE 2	// requests to a small helper forked at startup, that clones and execs
+
+
+/**************************************************************************************************************************
+Backend used to launch the commands (SPAWN_POSIX, SPAWN_FORK or SPAWN_ZYGOTE)
+**************************************************************************************************************************/
+extern unsigned int spawnBackend;
+
+
+/**************************************************************************************************************************
+Choose the backend by name ("posix_spawn", "fork" or "zygote"), NULL keeps the default.
+Return 0 if the name is unknown, else 1
+**************************************************************************************************************************/
+unsigned int setSpawnBackend(const char *);
+
+
+/**************************************************************************************************************************
+Launch the file path (already resolved by lookupCommand) with arguments argv, environment envp, fd_in as stdin and
+fd_out as stdout (-1 or less to inherit them) and close the n_close descriptors of fds_close in the child only. The
+child applies the scheduling sched before exec (NULL to keep the one of the shell).
+Return -1 if there is an error, else the pid of the child
+**************************************************************************************************************************/
+pid_t spawnCommand(const char *, char **, char **, int, int, const int *, int, const stageSched *);
+
+
+/**************************************************************************************************************************
+Give back to a child the signal mask of the shell: SIGPIPE is unblocked, the shell blocks it around the build in
+commands (parallel spawns while it runs).
+**************************************************************************************************************************/
+void childSigmask();
+
+
+/**************************************************************************************************************************
+Start the zygote, to call while the memory of the shell is still small: the zygote receives the commands on a
+socketpair and clones itself with CLONE_PARENT, so the commands are children of the shell (waited as usual).
+Return 0 if there is an error (posix_spawn is used), else 1
+**************************************************************************************************************************/
+unsigned int startZygote();
+
+
+/**************************************************************************************************************************
+Stop the zygote and wait for its end
+**************************************************************************************************************************/
+void stopZygote();
+
+#endif
@@ -0,0 +1,134 @@
+#define _GNU_SOURCE
+
+#include <sys/wait.h>
+#include <errno.h>
+#include "timing.h"
+#include "jobs.h"
+
+
+/**************************************************************************************************************************
+Seconds of the timeval
+**************************************************************************************************************************/
+static double seconds(struct timeval t)
+{
+	return t.tv_sec + t.tv_usec / 1e6;
+}
+
+
+/**************************************************************************************************************************
+Seconds from start to end
+**************************************************************************************************************************/
+static double elapsed(const struct timespec *start, const struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+
+/**************************************************************************************************************************
+after - before of the timeval
+**************************************************************************************************************************/
+static struct timeval subTime(struct timeval after, struct timeval before)
+{
+	after.tv_sec -= before.tv_sec;
+	if ((after.tv_usec -= before.tv_usec) < 0) {
+		after.tv_usec += 1000000;
+		after.tv_sec--;
+	}
+	return after;
+}
+
+
+/**************************************************************************************************************************
+Wait the n pids (0 is skipped) in the order they end with wait4, saving in st the status, the rusage and the time of
+each one. Children of the jobs in background reaped meanwhile are passed to the jobs.
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+unsigned int waitStages(int n, const pid_t *pids, stageTime *st)
+{
+	struct rusage usage;
+	int status, left = 0, i;
+	pid_t pid;
+	for (i = 0; i < n; i++)
+		if (pids[i] != 0) {
+			st[i].pid = pids[i];
+			left++;
+		}
+	while (left > 0) {
+		if ((pid = wait4(-1, &status, 0, &usage)) == -1) {
+			if (errno == EINTR)
+				continue;
+			return 0;
+		}
+		for (i = 0; i < n && pids[i] != pid; i++)
+			;
+		if (i == n) {	// not of the pipeline
+			jobsNotify(pid, status);
+			continue;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &st[i].end);
+		st[i].usage = usage;
+		st[i].status = status;
+		left--;
+	}
+	return 1;
+}
+
+
+/**************************************************************************************************************************
+Save in st the resources used by the shell since before (rusage of the shell when the command executed inside the
+shell started)
+**************************************************************************************************************************/
+void timeInProcess(stageTime * st, const struct rusage *before)
+{
+	struct rusage now;
+	clock_gettime(CLOCK_MONOTONIC, &st->end);
+	getrusage(RUSAGE_SELF, &now);
+	st->pid = 0;
+	st->usage = now;	// max RSS of the shell
+	st->usage.ru_utime = subTime(now.ru_utime, before->ru_utime);
+	st->usage.ru_stime = subTime(now.ru_stime, before->ru_stime);
+	st->usage.ru_nvcsw = now.ru_nvcsw - before->ru_nvcsw;
+	st->usage.ru_nivcsw = now.ru_nivcsw - before->ru_nivcsw;
+}
+
+
+/**************************************************************************************************************************
+Print on the stream the table of the n stages (wall time, user and sys CPU, max RSS, voluntary and involuntary context
+switches) and the total of the pipeline started at start.
+A child shares the memory of the shell until execve (posix_spawn, clone) or copies it (fork), and the kernel keeps the
+highest RSS of the whole life: a max RSS up to the peak of the shell can be the one of the shell, a note says it.
+**************************************************************************************************************************/
+void printTimes(FILE * out, const stageTime * st, int n, const struct timespec *start)
+{
+	struct rusage self;
+	double real = 0, user = 0, sys = 0;
+	long maxrss = 0, nvcsw = 0, nivcsw = 0;
+	unsigned int shared = 0;
+	getrusage(RUSAGE_SELF, &self);
+	fprintf(out, "%5s %8s %9s %9s %9s %10s %7s %7s  %s\n", "stage", "pid", "real", "user", "sys", "maxrss", "vcsw",
+		"ivcsw", "command");
+	for (int i = 0; i < n; i++) {
+		const struct rusage *u = &st[i].usage;
+		if (st[i].end.tv_sec == 0 && st[i].end.tv_nsec == 0)	// not started
+			continue;
+		if (elapsed(start, &st[i].end) > real)
+			real = elapsed(start, &st[i].end);
+		user += seconds(u->ru_utime);
+		sys += seconds(u->ru_stime);
+		maxrss = u->ru_maxrss > maxrss ? u->ru_maxrss : maxrss;
+		nvcsw += u->ru_nvcsw;
+		nivcsw += u->ru_nivcsw;
+		if (st[i].pid == 0)	// executed in the shell
+			fprintf(out, "%5d %8s", i + 1, "shell");
+		else
+			fprintf(out, "%5d %8d", i + 1, (int)st[i].pid);
+		if (st[i].pid != 0 && u->ru_maxrss <= self.ru_maxrss)	// maybe the memory of the shell
+			shared = 1;
+		fprintf(out, " %8.3fs %8.3fs %8.3fs %9ldk %7ld %7ld  %s\n", elapsed(start, &st[i].end), seconds(u->ru_utime),
+			seconds(u->ru_stime), u->ru_maxrss, u->ru_nvcsw, u->ru_nivcsw, st[i].name);
+	}
+	fprintf(out, "%5s %8s %8.3fs %8.3fs %8.3fs %9ldk %7ld %7ld\n", "total", "", real, user, sys, maxrss, nvcsw, nivcsw);
+	if (shared)
+		fprintf(out, "maxrss: a value up to %ldk (peak of the shell) may include the memory the command inherited\n",
+			self.ru_maxrss);
+}
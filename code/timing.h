@@ -0,0 +1,45 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stdio.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/resource.h>
+
+
+/**************************************************************************************************************************
+Resources used by a stage of a pipeline executed with "time": pid (0 for the command executed in the shell), time
+when it ended (0 if it didn't start), rusage and wait status
+**************************************************************************************************************************/
+typedef struct {
+	const char *name;
+	pid_t pid;
+	struct timespec end;
+	struct rusage usage;
+	int status;
+} stageTime;
+
+
+/**************************************************************************************************************************
+Wait the n pids (0 is skipped) in the order they end with wait4, saving in st the status, the rusage and the time of
+each one. Children of the jobs in background reaped meanwhile are passed to the jobs.
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+unsigned int waitStages(int, const pid_t *, stageTime *);
+
+
+/**************************************************************************************************************************
+Save in st the resources used by the shell since before (rusage of the shell when the command executed inside the
+shell started)
+**************************************************************************************************************************/
+void timeInProcess(stageTime *, const struct rusage *);
+
+
+/**************************************************************************************************************************
+Print on the stream the table of the n stages (wall time, user and sys CPU, max RSS, voluntary and involuntary context
+switches) and the total of the pipeline started at start. A max RSS of a child up to the peak of the shell may include
+the memory of the shell shared or copied before execve, a note under the table says it.
+**************************************************************************************************************************/
+void printTimes(FILE *, const stageTime *, int, const struct timespec *);
+
+#endif
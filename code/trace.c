@@ -0,0 +1,128 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "trace.h"
+
+
+/**************************************************************************************************************************
+Event of the trace: name (static string), start and duration in nanoseconds, detail copied from the line
+**************************************************************************************************************************/
+typedef struct {
+	const char *name;
+	long long start;
+	long long dur;
+	char detail[TRACEDETAIL];
+} traceEvent;
+
+unsigned int traceOn = 0;
+static traceEvent events[TRACEDIM];
+static unsigned int nEvents = 0;
+static unsigned int written = 0;	// events already in the file
+static FILE *traceFile = NULL;
+static int tracePid;
+
+
+/**************************************************************************************************************************
+Return the monotonic time in nanoseconds
+**************************************************************************************************************************/
+long long traceNow()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+
+/**************************************************************************************************************************
+Write the string in the file as a JSON string
+**************************************************************************************************************************/
+static void writeJsonString(const char *s)
+{
+	putc('"', traceFile);
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\')
+			fprintf(traceFile, "\\%c", *s);
+		else if ((unsigned char)*s < 0x20)
+			fprintf(traceFile, "\\u%04x", *s);
+		else
+			putc(*s, traceFile);
+	}
+	putc('"', traceFile);
+}
+
+
+/**************************************************************************************************************************
+Write the events in memory in the file and empty the buffer
+**************************************************************************************************************************/
+static void traceFlush()
+{
+	for (unsigned int i = 0; i < nEvents; i++) {
+		const traceEvent *e = &events[i];
+		fprintf(traceFile, "%s{\"name\":\"%s\",\"cat\":\"ubash\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d",
+			written++ > 0 ? ",\n" : "", e->name, e->start / 1e3, e->dur / 1e3, tracePid, tracePid);
+		if (e->detail[0] != '\0') {
+			fprintf(traceFile, ",\"args\":{\"detail\":");
+			writeJsonString(e->detail);
+			putc('}', traceFile);
+		}
+		putc('}', traceFile);
+	}
+	fflush(traceFile);	// nothing buffered is written again by a child at exit
+	nEvents = 0;
+}
+
+
+/**************************************************************************************************************************
+Start the trace in the file (Chrome trace format, opened by Perfetto and chrome://tracing).
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+unsigned int traceStart(const char *file)
+{
+	if ((traceFile = fopen(file, "w")) == NULL) {
+		fprintf(stderr, "micro-bash: %s: can't open the trace file\n", file);
+		return 0;
+	}
+	tracePid = getpid();
+	fprintf(traceFile, "[{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"ubash\"}}",
+		tracePid, tracePid);
+	fflush(traceFile);
+	written = 1;
+	traceOn = 1;
+	return 1;
+}
+
+
+/**************************************************************************************************************************
+Save the event name from start (traceNow) to now, detail can be NULL
+**************************************************************************************************************************/
+void traceSpan(const char *name, long long start, const char *detail)
+{
+	traceEvent *e;
+	if (nEvents == TRACEDIM)	// buffer full: one write for all the events
+		traceFlush();
+	e = &events[nEvents++];
+	e->name = name;
+	e->start = start;
+	e->dur = traceNow() - start;
+	if (detail != NULL)
+		snprintf(e->detail, TRACEDETAIL, "%s", detail);
+	else
+		e->detail[0] = '\0';
+}
+
+
+/**************************************************************************************************************************
+Write the events still in memory and close the file of the trace
+**************************************************************************************************************************/
+void traceStop()
+{
+	if (!traceOn)
+		return;
+	traceFlush();
+	fprintf(traceFile, "]\n");
+	fclose(traceFile);
+	traceOn = 0;
+}
@@ -0,0 +1,49 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#define TRACEDIM 4096	// events kept in memory before they are written to the file
+#define TRACEDETAIL 48	// chars of the detail of an event (name of the command)
+
+extern unsigned int traceOn;
+
+/**************************************************************************************************************************
+Time measured by a span: TRACE_START(t) saves the start in a new variable t (TRACE_RESTART in t again),
+TRACE_SPAN(t, "name", detail) saves the event from t to now. When tracing is off they only test traceOn, with
+-DNOTRACE they are removed
+**************************************************************************************************************************/
+#ifdef NOTRACE
+#define TRACE_START(t)
+#define TRACE_RESTART(t)
+#define TRACE_SPAN(t, name, detail)
+#else
+#define TRACE_START(t) long long t = traceOn ? traceNow() : 0
+#define TRACE_RESTART(t) t = traceOn ? traceNow() : 0
+#define TRACE_SPAN(t, name, detail) do { if (traceOn) traceSpan(name, t, detail); } while (0)
+#endif
+
+
+/**************************************************************************************************************************
+Start the trace in the file (Chrome trace format, opened by Perfetto and chrome://tracing).
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+unsigned int traceStart(const char *);
+
+
+/**************************************************************************************************************************
+Return the monotonic time in nanoseconds
+**************************************************************************************************************************/
+long long traceNow();
+
+
+/**************************************************************************************************************************
+Save the event name from start (traceNow) to now, detail can be NULL
+**************************************************************************************************************************/
+void traceSpan(const char *, long long, const char *);
+
+
+/**************************************************************************************************************************
+Write the events still in memory and close the file of the trace
+**************************************************************************************************************************/
+void traceStop();
+
+#endif
@@ -1,27 +1,137 @@
+#define _GNU_SOURCE
+
+#include <unistd.h>
+#include <string.h>
+#include <fcntl.h>
 #include "parsing.h"
+#include "spawn.h"
+#include "jobs.h"
+#include "session.h"
+#include "trace.h"
+#include "history.h"
+#include "plancache.h"
+#include "server.h"
+
+#define SCRIPTBUF 65536	// initial buffer used to read scripts in large blocks
 
 
 /**************************************************************************************************************************
 Main.
-Return 0 if there is an error, else 1
+Interactive mode with prompt when stdin is a terminal, otherwise script mode:
+ - ubash -c "commands"	run the commands in the string;
+ - ubash file.sh		run the commands in the file;
+ - ... | ubash		run the commands read from the pipe;
+ - ubash -l socket	server: run the commands sent by the clients on the Unix socket, each client in a child;
+ - ubash -r socket -c "commands"	client: run the commands in the server, with the stdio of the client.
+With -n the commands are only parsed, not executed, with -t file (or UBASH_TRACE=file) the time spent in each phase
+is written in the file in Chrome trace format (not in server mode).
+Return the exit status of the last command in script and client mode, else 0
 **************************************************************************************************************************/
 int main(int argc, char **argv)
 {
-	char comm[MAXCHARCOMM];
+	char *comm;
+	size_t blank;
+	int opt, fd = STDIN_FILENO, conn = -1;
+	const char *traceFile = getenv("UBASH_TRACE"), *commands = NULL, *listenPath = NULL, *serverPath = NULL;
 	queue q;
-	printf("\n##### uBASH - Laboratorio 2 di SET(i) 2019/2020 #####\n\n");
+	reader in;
+	interactive = isatty(STDIN_FILENO);
+	if (!setSpawnBackend(getenv("UBASH_SPAWN")))	// fork or posix_spawn
+		fprintf(stderr, "micro-bash: UBASH_SPAWN: unknown backend, using posix_spawn\n");
+	while ((opt = getopt(argc, argv, "+nc:t:l:r:")) != -1) {
+		switch (opt) {
+		case 'n':	// parse only
+			noExec = 1;
+			break;
+		case 't':	// trace of the session
+			traceFile = optarg;
+			break;
+		case 'c':	// commands from the string
+			commands = optarg;
+			interactive = 0;
+			break;
+		case 'l':	// server
+			listenPath = optarg;
+			interactive = 0;
+			break;
+		case 'r':	// client
+			serverPath = optarg;
+			break;
+		default:
+			fprintf(stderr, "usage: ubash [-n] [-t trace.json] [-c commands | file | -l socket] | ubash -r socket -c commands\n");
+			return 2;
+		}
+	}
+	if (serverPath != NULL) {	// nothing else to prepare in the client
+		if (commands == NULL || listenPath != NULL) {
+			fprintf(stderr, "usage: ubash -r socket -c commands\n");
+			return 2;
+		}
+		return runClient(serverPath, commands);
+	}
+	if (listenPath != NULL && (commands != NULL || optind < argc)) {
+		fprintf(stderr, "usage: ubash [-n] -l socket\n");
+		return 2;
+	}
+	if (commands == NULL && optind < argc) {	// commands from the file
+		if ((fd = open(argv[optind], O_RDONLY | O_CLOEXEC)) == -1) {
+			fprintf(stderr, "micro-bash: %s: File or directory doesn't exist\n", argv[optind]);
+			return 127;
+		}
+		interactive = 0;
+	}
+	if (spawnBackend == SPAWN_ZYGOTE && listenPath != NULL) {	// the clone would be a child of the server
+		fprintf(stderr, "micro-bash: UBASH_SPAWN: no zygote in server mode, using posix_spawn\n");
+		spawnBackend = SPAWN_POSIX;
+	} else if (spawnBackend == SPAWN_ZYGOTE)
+		startZygote();	// while the memory of the shell is small
+	if (listenPath == NULL && (commands != NULL ? !stringReader(&in, commands) : !openReader(&in, fd, SCRIPTBUF)))
+		return 2;	// the reader reads in large blocks
+	if (!interactive)
+		setvbuf(stdout, NULL, _IOLBF, 0);	// no buffered output duplicated by fork
+	else
+		printf("\n##### uBASH - Laboratorio 2 di SET(i) 2019/2020 #####\n\n");
+	if (traceFile != NULL && traceFile[0] != '\0' && listenPath == NULL)
+		traceStart(traceFile);
+	create(&q, QUEUEINLINE);
+	arenaInit(&lineArena, ARENABLOCK);
+	initJobs();
+	sessionInit();
+	if (listenPath != NULL && (conn = serveClients(listenPath, &in)) == -1)	// returns in the child of each client
+		return 2;
+	if (interactive)
+		initHistory();	// only the commands typed on the terminal
 	while (1) {
-		printCurDir();
-		if (!inputCommand(comm))	// take input and check if it's ctrl+D
-			return 0;
-		if (comm[0] == '\n')	// if the user insert an '\n' before first input
+		reapJobs(interactive);	// jobs ended in background
+		if (interactive)
+			printCurDir();
+		if ((comm = inputCommand(&in)) == NULL)	// take input and check if it's ctrl+D
+			break;
+		blank = strspn(comm, " \t");
+		if (comm[blank] == '\n' || comm[blank] == '\0' || comm[blank] == '#')	// empty line or comment
 			continue;
-		create(&q, MAXQUEUEELEM);
-		if (!parser(comm, &q)) {	// execute the parser
-			reset(&q);
-			continue;
-		}
-		reset(&q);
+		prevStatus = lastStatus;
+		lastStatus = 0;
+		if (!parser(comm, &q, &in) && lastStatus == 0)	// execute the parser
+			lastStatus = EXIT_FAILURE;
+		clear(&q);
+		arenaReset(&lineArena);	// free all the memory of the line
+	}
+	if (getenv("UBASH_STATS") != NULL) {	// allocation and plan cache counters
+		arenaStats(&lineArena, stderr);
+		planStats(stderr);
 	}
-	return 1;
+	traceStop();
+	freeHistory();
+	freePlans();
+	stopZygote();
+	arenaFree(&lineArena);
+	sessionFree();
+	reset(&q);
+	closeReader(&in);
+	if (fd != STDIN_FILENO)
+		close(fd);
+	if (conn != -1)
+		sendStatus(conn, lastStatus);
+	return interactive ? 0 : lastStatus;
 }
@@ -0,0 +1,380 @@
+#define _GNU_SOURCE
+
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "variables.h"
+#include "session.h"
+#include "parsing.h"
+
+#define MINVARDIM 128	// initial number of slots of the table, always a power of 2
+
+
+/**************************************************************************************************************************
+Slot of the table: the variable is saved as "name=value", so the environment is made of pointers to the slots
+**************************************************************************************************************************/
+typedef struct {
+	char *pair;		// NULL if the slot is free, removed if the variable was removed
+	size_t nameLen;
+	unsigned int flags;
+} varEntry;
+
+static char removed[] = "";	// slot of a removed variable, the search goes on
+static varEntry *table = NULL;
+static unsigned int tableDim = 0, tableUsed = 0, nExported = 0;
+
+
+/**************************************************************************************************************************
+FNV-1a hash of the first len chars
+**************************************************************************************************************************/
+static unsigned int hashName(const char *s, size_t len)
+{
+	unsigned int h = 2166136261u;
+	while (len-- > 0) {
+		h ^= (unsigned char)*s++;
+		h *= 16777619u;
+	}
+	return h;
+}
+
+
+/**************************************************************************************************************************
+Return the slot of the name of len chars (the first removed or free slot if it isn't in the table), linear probing
+**************************************************************************************************************************/
+static varEntry *findVar(varEntry *t, unsigned int dim, const char *name, size_t len)
+{
+	unsigned int i = hashName(name, len) & (dim - 1);
+	varEntry *firstRemoved = NULL;
+	for (; t[i].pair != NULL; i = (i + 1) & (dim - 1)) {
+		if (t[i].pair == removed) {
+			if (firstRemoved == NULL)
+				firstRemoved = &t[i];
+		} else if (t[i].nameLen == len && memcmp(t[i].pair, name, len) == 0)
+			return &t[i];
+	}
+	return firstRemoved != NULL ? firstRemoved : &t[i];
+}
+
+
+/**************************************************************************************************************************
+Double the table (the removed slots are dropped) when more than half is used.
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+static unsigned int growVars()
+{
+	varEntry *newTable;
+	unsigned int newDim = tableDim == 0 ? MINVARDIM : tableDim * 2;
+	if ((newTable = calloc(newDim, sizeof(varEntry))) == NULL)
+		return 0;
+	tableUsed = 0;
+	for (unsigned int i = 0; i < tableDim; i++)
+		if (table[i].pair != NULL && table[i].pair != removed) {
+			*findVar(newTable, newDim, table[i].pair, table[i].nameLen) = table[i];
+			tableUsed++;
+		}
+	free(table);
+	table = newTable;
+	tableDim = newDim;
+	return 1;
+}
+
+
+/**************************************************************************************************************************
+A variable of the environment changed: the environment is rebuilt at the next command, PATH is read again
+**************************************************************************************************************************/
+static void envChanged(const char *name, size_t len)
+{
+	free(shell.envp);
+	shell.envp = NULL;
+	if (len == 4 && memcmp(name, "PATH", 4) == 0) {
+		const char *path = getVar("PATH");
+		shell.path = path != NULL ? path : DEFAULTPATH;
+		shell.pathGen++;
+	}
+}
+
+
+/**************************************************************************************************************************
+Return the length of the variable name at the start of the string (letters, digits and '_', not starting with a
+digit), 0 if there isn't a name
+**************************************************************************************************************************/
+size_t nameLength(const char *s)
+{
+	size_t len = 0;
+	if (*s >= '0' && *s <= '9')
+		return 0;
+	while ((s[len] >= 'a' && s[len] <= 'z') || (s[len] >= 'A' && s[len] <= 'Z') || (s[len] >= '0' && s[len] <= '9')
+	       || s[len] == '_')
+		len++;
+	return len;
+}
+
+
+/**************************************************************************************************************************
+Save "name=value" in the slot of the name of len chars.
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+static unsigned int storeVar(const char *name, size_t len, const char *value, unsigned int flags)
+{
+	varEntry *slot;
+	size_t valueLen = strlen(value);
+	char *pair;
+	if (2 * (tableUsed + 1) > tableDim && !growVars())
+		return 0;
+	if ((pair = malloc(len + valueLen + 2)) == NULL)
+		return 0;
+	memcpy(pair, name, len);
+	pair[len] = '=';
+	memcpy(pair + len + 1, value, valueLen + 1);
+	slot = findVar(table, tableDim, name, len);
+	if (slot->pair == NULL || slot->pair == removed) {	// new variable
+		if (slot->pair == NULL)
+			tableUsed++;
+		slot->flags = 0;
+		slot->nameLen = len;
+	} else
+		free(slot->pair);
+	slot->pair = pair;
+	if ((flags & VAR_EXPORT) && !(slot->flags & VAR_EXPORT)) {
+		slot->flags |= VAR_EXPORT;
+		nExported++;
+	}
+	if (slot->flags & VAR_EXPORT)
+		envChanged(name, len);
+	return 1;
+}
+
+
+/**************************************************************************************************************************
+Fill the table of the variables with the environment, all the variables are exported
+**************************************************************************************************************************/
+void initVariables(char **envp)
+{
+	for (; *envp != NULL; envp++) {
+		size_t len = strcspn(*envp, "=");
+		if ((*envp)[len] == '=')
+			storeVar(*envp, len, *envp + len + 1, VAR_EXPORT);
+	}
+	envChanged("PATH", 4);
+}
+
+
+/**************************************************************************************************************************
+Free the table of the variables and the environment of the commands
+**************************************************************************************************************************/
+void freeVariables()
+{
+	for (unsigned int i = 0; i < tableDim; i++)
+		if (table[i].pair != removed)
+			free(table[i].pair);
+	free(table);
+	free(shell.envp);
+	table = NULL;
+	shell.envp = NULL;
+	tableDim = tableUsed = nExported = 0;
+}
+
+
+/**************************************************************************************************************************
+Return the slot of the variable name of len chars, NULL if it isn't set
+**************************************************************************************************************************/
+static varEntry *lookupVar(const char *name, size_t len)
+{
+	varEntry *slot;
+	if (tableDim == 0)
+		return NULL;
+	slot = findVar(table, tableDim, name, len);
+	return slot->pair == NULL || slot->pair == removed ? NULL : slot;
+}
+
+
+/**************************************************************************************************************************
+Return the value of the variable name of len chars, NULL if it isn't set
+**************************************************************************************************************************/
+static const char *valueOf(const char *name, size_t len)
+{
+	static char special[24];
+	varEntry *slot;
+	if (len == 1 && (*name == '?' || *name == '$')) {	// special variables
+		snprintf(special, sizeof(special), "%d", *name == '?' ? prevStatus : (int)getpid());
+		return special;
+	}
+	if ((slot = lookupVar(name, len)) == NULL)
+		return NULL;
+	return slot->pair + slot->nameLen + 1;
+}
+
+
+/**************************************************************************************************************************
+Return the value of the variable ("?" is the status of the previous line, "$" the pid of the shell), NULL if it isn't
+set
+**************************************************************************************************************************/
+const char *getVar(const char *name)
+{
+	return valueOf(name, strlen(name));
+}
+
+
+/**************************************************************************************************************************
+Set the variable, with VAR_EXPORT in flags it is exported, else it keeps its state.
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+unsigned int setVar(const char *name, const char *value, unsigned int flags)
+{
+	return storeVar(name, strlen(name), value, flags);
+}
+
+
+/**************************************************************************************************************************
+Set the variable from "name=value", with VAR_EXPORT in flags it is exported, else it keeps its state.
+Return 0 if there is an error (invalid name), else 1
+**************************************************************************************************************************/
+unsigned int assignVar(const char *assignment, unsigned int flags)
+{
+	size_t len = nameLength(assignment);
+	if (len == 0 || assignment[len] != '=')
+		return 0;
+	return storeVar(assignment, len, assignment + len + 1, flags);
+}
+
+
+/**************************************************************************************************************************
+Export the variable already set.
+Return 0 if it isn't set, else 1
+**************************************************************************************************************************/
+unsigned int exportVar(const char *name)
+{
+	varEntry *slot;
+	if ((slot = lookupVar(name, strlen(name))) == NULL)
+		return 0;
+	if (!(slot->flags & VAR_EXPORT)) {
+		slot->flags |= VAR_EXPORT;
+		nExported++;
+		envChanged(name, slot->nameLen);
+	}
+	return 1;
+}
+
+
+/**************************************************************************************************************************
+Remove the variable.
+Return 0 if there is an error (invalid name), else 1
+**************************************************************************************************************************/
+unsigned int unsetVar(const char *name)
+{
+	size_t len = strlen(name);
+	varEntry *slot;
+	if (len == 0 || nameLength(name) != len)
+		return 0;
+	if ((slot = lookupVar(name, len)) == NULL)
+		return 1;
+	free(slot->pair);
+	slot->pair = removed;
+	if (slot->flags & VAR_EXPORT) {
+		nExported--;
+		envChanged(name, len);
+	}
+	return 1;
+}
+
+
+/**************************************************************************************************************************
+Return the environment of the commands ("name=value" of the exported variables, ends with NULL), rebuilt only after a
+change of an exported variable
+**************************************************************************************************************************/
+char **exportedEnv()
+{
+	unsigned int n = 0;
+	if (shell.envp != NULL)
+		return shell.envp;
+	if ((shell.envp = malloc(sizeof(char *) * (nExported + 1))) == NULL)
+		return NULL;
+	for (unsigned int i = 0; i < tableDim; i++)
+		if (table[i].pair != NULL && table[i].pair != removed && (table[i].flags & VAR_EXPORT))
+			shell.envp[n++] = table[i].pair;
+	shell.envp[n] = NULL;
+	return shell.envp;
+}
+
+
+/**************************************************************************************************************************
+Return the environment of a command with the n "name=value" assignments written before it (allocated in the arena of
+the line), the environment of the shell if n is 0
+**************************************************************************************************************************/
+char **commandEnv(char **assign, int n)
+{
+	char **env = exportedEnv(), **cmdEnv;
+	int k = 0, i;
+	if (n == 0 || env == NULL)
+		return env;
+	cmdEnv = (char **)arenaAlloc(&lineArena, sizeof(char *) * (nExported + n + 1));
+	for (; *env != NULL; env++) {	// the variables not assigned
+		size_t len = strcspn(*env, "=");
+		for (i = 0; i < n && !(strncmp(assign[i], *env, len + 1) == 0); i++)
+			;
+		if (i == n)
+			cmdEnv[k++] = *env;
+	}
+	for (i = 0; i < n; i++)
+		cmdEnv[k++] = assign[i];
+	cmdEnv[k] = NULL;
+	return cmdEnv;
+}
+
+
+/**************************************************************************************************************************
+Return the value of the variable after the '$' in s ($name, ${name}, $? or $$) and in used the chars of s used.
+Return NULL if s isn't a variable ("$" is kept), "" if it isn't set
+**************************************************************************************************************************/
+static const char *expandVar(const char *s, size_t *used)
+{
+	const char *value;
+	size_t len;
+	if (*s == '?' || *s == '$') {
+		*used = 1;
+		return valueOf(s, 1);
+	}
+	if (*s == '{') {
+		len = nameLength(s + 1);
+		if (len == 0 || s[len + 1] != '}')
+			return NULL;
+		*used = len + 2;
+		value = valueOf(s + 1, len);
+	} else {
+		if ((len = nameLength(s)) == 0)
+			return NULL;
+		*used = len;
+		value = valueOf(s, len);
+	}
+	return value != NULL ? value : "";
+}
+
+
+/**************************************************************************************************************************
+Return the word with $name, ${name}, $? and $$ replaced by the values of the variables (empty if not set), allocated in
+the arena of the line ("$" not followed by a name is kept)
+**************************************************************************************************************************/
+char *expandWord(char *word)
+{
+	const char *s, *value;
+	char *result, *r;
+	size_t len = 0, used;
+	if (strchr(word, '$') == NULL)	// nothing to expand
+		return word;
+	for (s = word; *s; s++)	// length of the result
+		if (*s == '$' && (value = expandVar(s + 1, &used)) != NULL) {
+			len += strlen(value);
+			s += used;
+		} else
+			len++;
+	r = result = (char *)arenaAlloc(&lineArena, len + 1);
+	for (s = word; *s; s++)
+		if (*s == '$' && (value = expandVar(s + 1, &used)) != NULL) {
+			r = stpcpy(r, value);
+			s += used;
+		} else
+			*r++ = *s;
+	*r = '\0';
+	return result;
+}
@@ -0,0 +1,83 @@
+#ifndef VARIABLES_H
+#define VARIABLES_H
+
+#include <stddef.h>
+
+#define VAR_EXPORT 1	// the variable is in the environment of the commands
+
+
+/**************************************************************************************************************************
+Fill the table of the variables with the environment, all the variables are exported
+**************************************************************************************************************************/
+void initVariables(char **);
+
+
+/**************************************************************************************************************************
+Free the table of the variables and the environment of the commands
+**************************************************************************************************************************/
+void freeVariables();
+
+
+/**************************************************************************************************************************
+Return the length of the variable name at the start of the string (letters, digits and '_', not starting with a
+digit), 0 if there isn't a name
+**************************************************************************************************************************/
+size_t nameLength(const char *);
+
+
+/**************************************************************************************************************************
+Return the value of the variable ("?" is the status of the previous line, "$" the pid of the shell), NULL if it isn't
+set
+**************************************************************************************************************************/
+const char *getVar(const char *);
+
+
+/**************************************************************************************************************************
+Set the variable, with VAR_EXPORT in flags it is exported, else it keeps its state.
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+unsigned int setVar(const char *, const char *, unsigned int);
+
+
+/**************************************************************************************************************************
+Set the variable from "name=value", with VAR_EXPORT in flags it is exported, else it keeps its state.
+Return 0 if there is an error (invalid name), else 1
+**************************************************************************************************************************/
+unsigned int assignVar(const char *, unsigned int);
+
+
+/**************************************************************************************************************************
+Export the variable already set.
+Return 0 if it isn't set, else 1
+**************************************************************************************************************************/
+unsigned int exportVar(const char *);
+
+
+/**************************************************************************************************************************
+Remove the variable.
+Return 0 if there is an error (invalid name), else 1
+**************************************************************************************************************************/
+unsigned int unsetVar(const char *);
+
+
+/**************************************************************************************************************************
+Return the environment of the commands ("name=value" of the exported variables, ends with NULL), rebuilt only after a
+change of an exported variable
+**************************************************************************************************************************/
+char **exportedEnv();
+
+
+/**************************************************************************************************************************
+Return the environment of a command with the n "name=value" assignments written before it (allocated in the arena of
+the line), the environment of the shell if n is 0
+**************************************************************************************************************************/
+char **commandEnv(char **, int);
+
+
+/**************************************************************************************************************************
+Return the word with $name, ${name}, $? and $$ replaced by the values of the variables (empty if not set), allocated in
+the arena of the line ("$" not followed by a name is kept)
+**************************************************************************************************************************/
+char *expandWord(char *);
+
+#endif
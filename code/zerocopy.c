@@ -0,0 +1,217 @@
+#define _GNU_SOURCE
+
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+#include "zerocopy.h"
+#include "parsing.h"
+
+#define CHUNK (1 << 20)	// max bytes moved by one system call
+#define BUFDIM 65536	// buffer for read/write
+
+
+/**************************************************************************************************************************
+Write all the n bytes of buf.
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+static unsigned int writeAll(int fd, const char *buf, ssize_t n)
+{
+	ssize_t w;
+	while (n > 0) {
+		if ((w = write(fd, buf, n)) == -1) {
+			if (errno == EINTR)
+				continue;
+			return 0;
+		}
+		buf += w;
+		n -= w;
+	}
+	return 1;
+}
+
+
+/**************************************************************************************************************************
+Copy with read and write.
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+static unsigned int copyRead(int in, int out)
+{
+	char *buf = malloc(BUFDIM);
+	ssize_t n;
+	unsigned int ok = buf != NULL;
+	while (ok && (n = read(in, buf, BUFDIM)) != 0) {
+		if (n == -1) {
+			if (errno == EINTR)
+				continue;
+			ok = 0;
+		} else
+			ok = writeAll(out, buf, n);
+	}
+	free(buf);
+	return ok;
+}
+
+
+/**************************************************************************************************************************
+Copy all the data from in to out with the fastest way for the two files: copy_file_range between regular files,
+splice if one of them is a pipe, sendfile from a regular file, read/write otherwise.
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+unsigned int copyData(int in, int out)
+{
+	struct stat stIn, stOut;
+	ssize_t n = -1;
+	if (fstat(in, &stIn) == -1 || fstat(out, &stOut) == -1)
+		return 0;
+	errno = 0;
+	// each loop ends at the end of the data (0) or when the call can't be used with these files (-1)
+	if (S_ISREG(stIn.st_mode) && S_ISREG(stOut.st_mode) && !(fcntl(out, F_GETFL) & O_APPEND))
+		while ((n = copy_file_range(in, NULL, out, NULL, CHUNK, 0)) > 0)
+			;
+	if (n == -1 && (S_ISFIFO(stIn.st_mode) || S_ISFIFO(stOut.st_mode)))
+		while ((n = splice(in, NULL, out, NULL, CHUNK, SPLICE_F_MOVE | SPLICE_F_MORE)) > 0)
+			;
+	if (n == -1 && S_ISREG(stIn.st_mode))
+		while ((n = sendfile(out, in, NULL, CHUNK)) > 0)
+			;
+	if (n == 0)
+		return 1;
+	if (errno == EPIPE)	// the reader has ended
+		return 0;
+	return copyRead(in, out);	// the data already moved is not copied again
+}
+
+
+/**************************************************************************************************************************
+Build in cat command executed in the shell: cat [file|-]... (without files it copies fd_in).
+fd_in and fd_out are the input and output of the command (-2 for stdin and stdout).
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+unsigned int catBuiltin(char **args, int num_arg, int fd_in, int fd_out)
+{
+	unsigned int ok = 1;
+	int fd;
+	if (fd_in < 0)
+		fd_in = STDIN_FILENO;
+	if (fd_out < 0)
+		fd_out = STDOUT_FILENO;
+	if (num_arg == 1)
+		return copyData(fd_in, fd_out);
+	for (int i = 1; i < num_arg; i++) {
+		if (strcmp(args[i], "-") == 0) {
+			ok = copyData(fd_in, fd_out) && ok;
+			continue;
+		}
+		if ((fd = open(args[i], O_RDONLY | O_CLOEXEC)) == -1) {
+			fprintf(stderr, "cat: %s: %s\n", args[i], strerror(errno));
+			ok = 0;
+			continue;
+		}
+		ok = copyData(fd, fd_out) && ok;
+		close(fd);
+	}
+	return ok;
+}
+
+
+/**************************************************************************************************************************
+tee between two pipes with one file: the data is duplicated in out without copies (tee) and then moved from in to the
+file (splice).
+Return -1 if tee or splice can't be used (nothing is lost), 0 if there is an error, else 1
+**************************************************************************************************************************/
+static int teeSplice(int in, int out, int file)
+{
+	ssize_t n, m;
+	char *buf;
+	while ((n = tee(in, out, CHUNK, 0)) > 0) {
+		while (n > 0 && (m = splice(in, NULL, file, NULL, n, SPLICE_F_MOVE)) > 0)
+			n -= m;
+		if (n == 0)
+			continue;
+		// the file doesn't accept splice: the data is already in out, only the file needs it
+		if ((buf = malloc(n)) == NULL)
+			return 0;
+		m = read(in, buf, n);
+		if (m != n || !writeAll(file, buf, n)) {
+			free(buf);
+			return 0;
+		}
+		free(buf);
+		return -1;
+	}
+	if (n == -1 && errno == EINVAL)
+		return -1;
+	return n == 0;
+}
+
+
+/**************************************************************************************************************************
+Build in tee command executed in the shell: tee [-a] [file]... copies fd_in on fd_out and on the files. With two pipes
+and one file the data is duplicated with tee(2) and moved to the file with splice.
+fd_in and fd_out are the input and output of the command (-2 for stdin and stdout).
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+unsigned int teeBuiltin(char **args, int num_arg, int fd_in, int fd_out)
+{
+	int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, first = 1, n_files = 0, *files, ret = -1;
+	unsigned int ok = 1;
+	struct stat stIn, stOut;
+	ssize_t n;
+	char *buf;
+	if (fd_in < 0)
+		fd_in = STDIN_FILENO;
+	if (fd_out < 0)
+		fd_out = STDOUT_FILENO;
+	if (num_arg > 1 && strcmp(args[1], "-a") == 0) {	// append
+		flags = O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC;
+		first = 2;
+	}
+	if ((files = malloc(sizeof(int) * (num_arg + 1))) == NULL)
+		return 0;
+	files[n_files++] = fd_out;
+	for (int i = first; i < num_arg; i++) {
+		if ((files[n_files] = open(args[i], flags, 0666)) == -1) {
+			fprintf(stderr, "tee: %s: %s\n", args[i], strerror(errno));
+			ok = 0;
+			continue;
+		}
+		n_files++;
+	}
+	if (n_files == 1)	// like cat
+		ret = copyData(fd_in, fd_out);
+	else if (n_files == 2 && fstat(fd_in, &stIn) == 0 && fstat(fd_out, &stOut) == 0
+		 && S_ISFIFO(stIn.st_mode) && S_ISFIFO(stOut.st_mode))
+		ret = teeSplice(fd_in, fd_out, files[1]);
+	if (ret == -1 && (buf = malloc(BUFDIM)) != NULL) {	// read once and write on all the files
+		ret = 1;
+		while ((n = read(fd_in, buf, BUFDIM)) != 0) {
+			if (n == -1) {
+				if (errno == EINTR)
+					continue;
+				ret = 0;
+				break;
+			}
+			if (!writeAll(fd_out, buf, n)) {	// the reader has ended
+				ret = 0;
+				break;
+			}
+			for (int i = 1; i < n_files; i++)
+				if (files[i] >= 0 && !writeAll(files[i], buf, n)) {
+					ret = 0;	// the other files are still written
+					close(files[i]);
+					files[i] = -1;
+				}
+		}
+		free(buf);
+	}
+	for (int i = 1; i < n_files; i++)
+		if (files[i] >= 0)
+			close(files[i]);
+	free(files);
+	return ok && ret == 1;
+}
@@ -0,0 +1,29 @@
+#ifndef ZEROCOPY_H
+#define ZEROCOPY_H
+
+
+/**************************************************************************************************************************
+Copy all the data from in to out with the fastest way for the two files: copy_file_range between regular files,
+splice if one of them is a pipe, sendfile from a regular file, read/write otherwise.
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+unsigned int copyData(int, int);
+
+
+/**************************************************************************************************************************
+Build in cat command executed in the shell: cat [file|-]... (without files it copies fd_in).
+fd_in and fd_out are the input and output of the command (-2 for stdin and stdout).
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+unsigned int catBuiltin(char **, int, int, int);
+
+
+/**************************************************************************************************************************
+Build in tee command executed in the shell: tee [-a] [file]... copies fd_in on fd_out and on the files. With two pipes
+and one file the data is duplicated with tee(2) and moved to the file with splice.
+fd_in and fd_out are the input and output of the command (-2 for stdin and stdout).
+Return 0 if there is an error, else 1
+**************************************************************************************************************************/
+unsigned int teeBuiltin(char **, int, int, int);
+
+#endif
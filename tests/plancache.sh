@@ -0,0 +1,62 @@
+#!/bin/bash
+# Checks of the plan cache, run with: make check
+#
+# The same line is executed twice and the command it resolves changes in between: the second run must execute the
+# new command, not the path remembered by the plan of the first run.
+
+cd "$(dirname "$0")/.." || exit 1
+
+UBASH=${UBASH:-./ubash}
+WORK=$(mktemp -d "${TMPDIR:-/tmp}/ubash-check.XXXXXX")
+trap 'rm -rf "$WORK"' EXIT
+FAILED=0
+
+if [ ! -x "$UBASH" ]; then
+	echo "check: $UBASH not found, run make first" >&2
+	exit 1
+fi
+
+# check name expected: the output of ubash on the script $WORK/script.sh must be expected
+check() {
+	local out
+	out=$("$UBASH" "$WORK/script.sh" 2>&1 </dev/null)
+	if [ "$out" = "$2" ]; then
+		echo "  $1: ok"
+	else
+		echo "  $1: FAILED, expected \"$2\", got \"$out\""
+		FAILED=$((FAILED + 1))
+	fi
+}
+
+mkdir -p "$WORK/first" "$WORK/second"
+printf '#!/bin/sh\necho first\n' > "$WORK/first/tool"
+printf '#!/bin/sh\necho second\n' > "$WORK/second/tool"
+chmod +x "$WORK/first/tool" "$WORK/second/tool"
+
+# PATH changes between the two runs
+cat > "$WORK/script.sh" <<EOF
+PATH=$WORK/first:$WORK/second
+tool
+PATH=$WORK/second:$WORK/first
+tool
+EOF
+check path_changed "first
+second"
+
+# a new command comes first in PATH, found after hash -r
+mkdir -p "$WORK/empty"
+cat > "$WORK/script.sh" <<EOF
+PATH=$WORK/empty:$WORK/first
+tool
+/bin/cp $WORK/second/tool $WORK/empty/tool
+hash -r
+tool
+EOF
+check hash_r "first
+second"
+
+if [ "$FAILED" -gt 0 ]; then
+	echo "$FAILED check(s) failed"
+	exit 1
+fi
+exit 0